@@ -98,6 +98,16 @@ BarWidget::BarWidget(Widget* parent, int16_t px, int16_t py, uint16_t pwidth, ui
   widgetSize = sizeof(BarWidget);
 }
 
+/*-------------------------------------------------------------------------------
+ *
+ *  Destructor, a bar deleted while animating is taken out of the animation
+ *  chain, so BarAnimation does not step it anymore.
+ *
+ *-----------------------------------------------------------------------------*/
+BarWidget::~BarWidget() {
+  BarAnimation.stop(this);
+}
+
 void BarWidget::draw() {
   inverted = false;
 
@@ -163,45 +173,17 @@ void BarWidget::update(uint16_t percentage) {
 		percentage = 100;
 
 	//
-	// No update needed
+	//  An animated bar only gets a new target. The BarAnimator task
+	//  moves the bar towards it a few pixels per tick.
 	//
-	if (oldPercentage == percentage)
+	targetPercentage = percentage;
+	if (animated && oldPercentage != percentage) {
+		BarAnimation.start(this);
 		return;
-
-	if (1) {
-		updateIncr(percentage);
-		oldPercentage = percentage;
 	}
-	else {
-	  bool up = oldPercentage < percentage;
-	  uint16_t running;
-
-	  if (up)
-		running = oldPercentage++;
-	  else
-		running = oldPercentage--;
 
-	  //
-	  //  Update only a slice
-	  //
-	  int i = 0;
-	  while (i < 10 && running != percentage) {
-
-		updateIncr(running);
-		oldPercentage = running;
-
-		if (up)
-			running++;
-		else
-			running--;
-
-		i++;
-	  }
-
-	  updateIncr(running);
-
-	  oldPercentage = running; // save the running percentage
-	}
+	BarAnimation.stop(this);
+	updateIncr(percentage);
 //	delay(500);
 }
 
@@ -211,8 +193,6 @@ void BarWidget::updateIncr(uint16_t runningPercentage) {
 	  return;
   }
 
-  uint16_t color = 0xFFFF;
-
   uint16_t updateWidth = width - 2*stroke;
   uint16_t updateX     = x + stroke;
 
@@ -248,67 +228,97 @@ void BarWidget::updateIncr(uint16_t runningPercentage) {
     //
     else {
         //
-        //  Color from zero to LowLow border
+        //  Only the part between the old and the new percentage is drawn,
+        //  in the color of the level band it falls in.
         //
-        color = RED;
-        if (oldPercentage < levels->lowlow && runningPercentage > 0.0) {
-          int16_t y = runningPercentage <= levels->lowlow ? level2y(runningPercentage) : level2y(levels->lowlow);
-          Screen.fillRect(updateX,     y,
-                               updateWidth, level2y(levels->min) - y,
-                               color);
-        }
+        fillBand(oldPercentage, runningPercentage, levels->min,      levels->lowlow,   RED);
+        fillBand(oldPercentage, runningPercentage, levels->lowlow,   levels->low,      YELLOW);
+        fillBand(oldPercentage, runningPercentage, levels->low,      levels->high,     GREEN);
+        fillBand(oldPercentage, runningPercentage, levels->high,     levels->highhigh, BLUE);
+        fillBand(oldPercentage, runningPercentage, levels->highhigh, levels->max,      CYAN);
+    }
+  }
 
-        //
-        //  Color from LowLow to Low border
-        //
-        color = YELLOW;
-        if (oldPercentage < levels->low && runningPercentage > levels->lowlow) {
-          int16_t y = runningPercentage <= levels->low ? level2y(runningPercentage) : level2y(levels->low);
-          Screen.fillRect(updateX,     y,
-                               updateWidth, level2y(levels->lowlow) - y,
-                               color);
-        }
+  //
+  //  Make percentage the old percentage, because it will be at the next update invocation
+  //
+  oldPercentage = runningPercentage;
 
-        //
-        //  Color up to High border
-        //
-        color = GREEN;
-        if (oldPercentage < levels->high && runningPercentage > levels->low) {
-          int16_t y = runningPercentage <= levels->high ? level2y(runningPercentage) : level2y(levels->high);
-          Screen.fillRect(updateX,     y,
-                               updateWidth, level2y(levels->low) - y,
-                               color);
-        }
+}
 
-        //
-        //  Color up to HighHigh border
-        //
-        color = BLUE;
-        if (oldPercentage < levels->highhigh && runningPercentage > levels->high) {
-          int16_t y = runningPercentage <= levels->highhigh ? level2y(runningPercentage) : level2y(levels->highhigh);
-          Screen.fillRect(updateX,     y,
-                               updateWidth, level2y(levels->high) - y,
-                               color);
-        }
+/*------------------------------------------------------------------------------
+ *
+ *  Fill the part of a level band that lies between two percentages.
+ *
+ *  from      The lower percentage
+ *  to        The higher percentage
+ *  bandLow   The lower border of the band
+ *  bandHigh  The upper border of the band
+ *  color     The color of the band
+ *
+ *----------------------------------------------------------------------------*/
+void BarWidget::fillBand(uint16_t from, uint16_t to, uint16_t bandLow, uint16_t bandHigh, uint16_t color) {
+  if (from < bandLow)
+    from = bandLow;
+  if (to > bandHigh)
+    to = bandHigh;
 
-        //
-        //  Color up to Max border
-        //
-        color = CYAN;
-        if (runningPercentage > levels->highhigh) {
-          int16_t y = runningPercentage <= levels->max ? level2y(runningPercentage) : level2y(levels->max);
-          Screen.fillRect(updateX,     y,
-                               updateWidth, level2y(levels->highhigh) - y,
-                               color);
-        }
-    }
+  if (to <= from)
+    return;
+
+  int16_t yTo = level2y(to);
+  Screen.fillRect(x + stroke, yTo, width - 2*stroke, level2y(from) - yTo, color);
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Returns the number of pixels drawn when the bar goes from one percentage
+ *  to the other.
+ *
+ *----------------------------------------------------------------------------*/
+uint32_t BarWidget::stepCost(uint16_t from, uint16_t to) {
+  int16_t rows = (int16_t)level2y(from) - (int16_t)level2y(to);
+  if (rows < 0)
+    rows = -rows;
+
+  return (uint32_t)(width - 2*stroke) * rows;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Move the bar towards its target percentage, drawing at most budget
+ *  pixels. The first percent step is always taken, so a bar keeps moving
+ *  even if a single step costs more than the budget.
+ *
+ *  budget    The number of pixels the bar may draw
+ *
+ *  Returns the number of pixels drawn.
+ *
+ *----------------------------------------------------------------------------*/
+uint32_t BarWidget::animate(uint32_t budget) {
+  if (!isVisible())
+    return 0;
+
+  uint16_t running = oldPercentage;
+  uint32_t used    = 0;
+
+  while (running != targetPercentage) {
+    uint16_t next = running < targetPercentage ? running + 1 : running - 1;
+    uint32_t cost = stepCost(running, next);
+
+    if (used + cost > budget && running != oldPercentage)
+      break;
+
+    used   += cost;
+    running = next;
   }
 
   //
-  //  Make percentage the old percentage, because it will be at the next update invocation
+  //  All steps of this tick are drawn at once
   //
-  oldPercentage = runningPercentage;
+  updateIncr(running);
 
+  return used;
 }
 
 void drawInverted() {
@@ -324,11 +334,128 @@ void BarWidget::redraw() {
   if (!isVisible())
 	  return;
 
+  uint16_t level = oldPercentage;
+
   if (! inverted)
     draw();
   else
     drawInverted();
 
+  //
+  //  The frame is empty again, fill it to the level it had. An animated
+  //  bar that has not reached its target yet moves on from there.
+  //
   oldPercentage = 0;
+  updateIncr(level);
+}
 
+/*==============================================================================
+ *
+ *  The BarAnimator moves animated bars to their target percentage. Every
+ *  tick each bar may draw barPixelBudget pixels and all bars together may
+ *  draw framePixelBudget pixels. So a jump from 0 to 100% is spread over a
+ *  number of ticks and never stalls the digestion of touches.
+ *
+ *  Schedule BarAnimation as a Task, or call BarAnimation.exec() from loop().
+ *
+ *============================================================================*/
+
+/*------------------------------------------------------------------------------
+ *
+ *  Create the bar animator.
+ *  If scheduled as a Task its task name is BarAnimator, its cycle time is 20ms
+ *
+ *----------------------------------------------------------------------------*/
+BarAnimator::BarAnimator() :
+             Task("BarAnimator", 20) {
 }
+
+/*------------------------------------------------------------------------------
+ *
+ *  Advance every animating bar within the pixel budgets. If the frame
+ *  budget runs out, the next tick starts with the first bar that did not
+ *  get its turn.
+ *
+ *----------------------------------------------------------------------------*/
+void BarAnimator::exec() {
+  pixelsDrawn = 0;
+
+  if (!first)
+    return;
+
+  uint16_t count = 0;
+  for (BarWidget* bar = first; bar; bar = bar->nextAnimated)
+    count++;
+
+  BarWidget* bar    = resume ? resume : first;
+  uint32_t   budget = framePixelBudget;
+  resume            = nullptr;
+
+  while (count-- && bar) {
+    if (!budget) {
+      resume = bar;
+      break;
+    }
+
+    BarWidget* following = bar->nextAnimated ? bar->nextAnimated : first;
+
+    uint32_t used = bar->animate(barPixelBudget < budget ? barPixelBudget : budget);
+    budget       -= used < budget ? used : budget;
+    pixelsDrawn  += used;
+
+    if (!bar->isVisible() || bar->oldPercentage == bar->targetPercentage)
+      stop(bar);
+
+    bar = following == bar ? nullptr : following;
+  }
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Animate a bar until it reaches its target percentage.
+ *
+ *  bar       The bar to animate
+ *
+ *----------------------------------------------------------------------------*/
+void BarAnimator::start(BarWidget* bar) {
+  BarWidget** link = &first;
+
+  while (*link) {
+    if (*link == bar)
+      return;
+    link = &(*link)->nextAnimated;
+  }
+
+  bar->nextAnimated = nullptr;
+  *link             = bar;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Stop animating a bar. It stays at the percentage it has reached.
+ *
+ *  bar       The bar to stop animating
+ *
+ *----------------------------------------------------------------------------*/
+void BarAnimator::stop(BarWidget* bar) {
+  for (BarWidget** link = &first; *link; link = &(*link)->nextAnimated) {
+    if (*link == bar) {
+      *link = bar->nextAnimated;
+      if (resume == bar)
+        resume = bar->nextAnimated;
+      bar->nextAnimated = nullptr;
+      return;
+    }
+  }
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Returns true if any bar is still moving towards its target.
+ *
+ *----------------------------------------------------------------------------*/
+bool BarAnimator::isAnimating() {
+  return first != nullptr;
+}
+
+BarAnimator BarAnimation;	// Animates the bars that have animated set
@@ -51,17 +51,29 @@
  *  B A R  W I D G E T
  *===========================================================================*/
 class BarWidget : public RectangleWidget {
+  friend class BarAnimator;
+
   private:
-    uint16_t animated        = 0;
     uint16_t colorBackground = 0;
     uint16_t colorEdge       = 0xffff;
 //    uint16_t percentage      = 0;		// The current percentage
+    uint16_t targetPercentage = 0;       // The percentage an animation moves to
+    BarWidget* nextAnimated  = nullptr;  // Next bar in the animation chain
 
     uint16_t level2y(uint16_t percentage);
 
     void         updateIncr(uint16_t percentage);  // Incremental updates
+    void         fillBand(uint16_t from,           // Fill the part of a level band between two percentages
+                          uint16_t to,
+                          uint16_t bandLow,
+                          uint16_t bandHigh,
+                          uint16_t color);
+    uint32_t     stepCost(uint16_t from,           // Pixels drawn when going from one percentage to the other
+                          uint16_t to);
+    uint32_t     animate(uint32_t budget);         // Move towards the target within a pixel budget
 
   public:
+    bool     animated        = false;   // update() animates instead of drawing at once
     uint16_t oldPercentage   = 0;
     uint16_t tickStroke;      // The stroke thickness of the ticks
     uint16_t tickLength;      // Length of the tick
@@ -74,7 +86,7 @@ class BarWidget : public RectangleWidget {
                  int16_t px, int16_t py, uint16_t pwidth, uint16_t pheight, 
                  uint16_t pBgColor, uint16_t pStroke, uint16_t pStrokeColor, uint16_t pTickLength, 
                  uint16_t pTickStroke, Levels* pLevels, String pUnit);
-//    virtual ~BarWidget();
+    virtual ~BarWidget();
 
     virtual void draw();
     virtual void redraw();
@@ -83,4 +95,36 @@ class BarWidget : public RectangleWidget {
 //    virtual void onEvent(TouchEvent* event);
 };
 
+/*============================================================================
+ *  B A R  A N I M A T O R
+ *===========================================================================*/
+#ifndef BAR_FRAME_PIXEL_BUDGET
+#define BAR_FRAME_PIXEL_BUDGET  4096    // Pixels all animating bars may draw per tick
+#endif
+
+#ifndef BAR_PIXEL_BUDGET
+#define BAR_PIXEL_BUDGET        1024    // Pixels a single animating bar may draw per tick
+#endif
+
+class BarAnimator : public Task {
+  private:
+    BarWidget* first           = nullptr;   // The bars being animated
+    BarWidget* resume          = nullptr;   // The bar to start with on the next tick
+
+  public:
+    uint32_t   framePixelBudget = BAR_FRAME_PIXEL_BUDGET;
+    uint32_t   barPixelBudget   = BAR_PIXEL_BUDGET;
+    uint32_t   pixelsDrawn      = 0;        // Pixels drawn during the last tick
+
+               BarAnimator();
+
+    virtual void exec();                    // Advance the animating bars one tick
+
+    void       start(BarWidget* bar);       // Animate a bar until it reaches its target
+    void       stop(BarWidget* bar);        // Stop animating a bar
+    bool       isAnimating();               // True if any bar is still moving
+};
+
+extern BarAnimator BarAnimation;
+
 #endif
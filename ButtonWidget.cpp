@@ -175,6 +175,7 @@ void ButtonWidget::onTouch(TouchEvent* event) {
 #if DEBUG_ON_EVENT
 	Serial.print(F("Button touch")); Serial.println(id);
 #endif
+	Touch.drift.hit(this);
 	drawInverted();
 	action(event);
 }
@@ -104,6 +104,52 @@ Calibrator::Calibrator(Widget* parent, uint16_t pWidth, uint16_t pHeight, uint16
 
 }
 
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Clears the screen and prints the explanation of the calibration procedure
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::explanation() {
+
+  Screen.tft->fillScreen(BLACK);
+  Screen.tft->setCursor(0, 0);
+
+  Screen.tft->println(F(".^-^."));
+  Screen.tft->println(F(" o o"));
+  Screen.tft->println(F("  |"));
+  Screen.tft->println(F(" \\_/"));
+  Screen.tft->println();
+  Screen.tft->println(F("This TFT screen needs to be calibrated only once."));
+  Screen.tft->println(F("Recalibration can be started from within your application as well."));
+  Screen.tft->println(F("Below the calibration procedure is explained."));
+  Screen.tft->println();
+  Screen.tft->println(F("Calibration procedure explanation."));
+  Screen.tft->println(F("----------------------------------"));
+  Screen.tft->println(F("A grid of lines with RED markers will be drawn."));
+  Screen.tft->println(F("One of the markers will be WHITE."));
+  Screen.tft->println(F("ONLY tap on WHITE markers. Tap at its centre."));
+  Screen.tft->println(F("Be as accurate as possible."));
+  Screen.tft->println();
+  Screen.tft->println(F("Most markers looks like a '+'. Screen edge markers look like a 'T',"));
+  Screen.tft->println(F("or this '|-', or this '-|' or like an upside down 'T'"));
+  Screen.tft->println(F("Tap markers close to where the two lines cross."));
+  Screen.tft->println();
+  Screen.tft->println(F("After a tap, a WHITE marker will turn RED, signalling you tapped,"));
+  Screen.tft->println(F("A little later it will turn WHITE again. Signalling you need to tap it again."));
+  Screen.tft->println(F("A marker must be tapped 3 times successfully in a row, for accuracy reasons."));
+  Screen.tft->println(F("Then a marker is calibrated and a next marker will turn WHITE."));
+  Screen.tft->println();
+  Screen.tft->println(F("You can tap anywhere and still the marker turns RED... or BLUE."));
+  Screen.tft->println(F("A BLUE marker implies a calibration error and will restart for that marker."));
+  Screen.tft->println(F("Staying BLUE for about 1 second, then the marker becomes WHITE again."));
+  Screen.tft->println();
+  Screen.tft->println(F("After having calibrated all markers, the grid will automatically disappear."));
+  Screen.tft->println(F("And your application will start running. After some time :-)"));
+  Screen.tft->println(F("That's all there is to know..."));
+  Screen.tft->println();
+  Screen.tft->println(F("Ready reading this? Just tap to start calibrating..."));
+}
+
 /*--------------------------------------------------------------------------------------------------
  *
  *  Clears the screen and print help information about the calibration procedure
@@ -111,47 +157,8 @@ Calibrator::Calibrator(Widget* parent, uint16_t pWidth, uint16_t pHeight, uint16
  *------------------------------------------------------------------------------------------------*/
 void Calibrator::explain() {
 
-
   do {
-    long now = 0;
-
-    Screen.tft->fillScreen(BLACK);
-    Screen.tft->setCursor(0, 0);
-
-    Screen.tft->println(F(".^-^."));
-    Screen.tft->println(F(" o o"));
-    Screen.tft->println(F("  |"));
-    Screen.tft->println(F(" \\_/"));
-    Screen.tft->println();
-    Screen.tft->println(F("This TFT screen needs to be calibrated only once."));
-    Screen.tft->println(F("Recalibration can be started from within your application as well."));
-    Screen.tft->println(F("Below the calibration procedure is explained."));
-    Screen.tft->println();
-    Screen.tft->println(F("Calibration procedure explanation."));
-    Screen.tft->println(F("----------------------------------"));
-    Screen.tft->println(F("A grid of lines with RED markers will be drawn."));
-    Screen.tft->println(F("One of the markers will be WHITE."));
-    Screen.tft->println(F("ONLY tap on WHITE markers. Tap at its centre."));
-    Screen.tft->println(F("Be as accurate as possible."));
-    Screen.tft->println();
-    Screen.tft->println(F("Most markers looks like a '+'. Screen edge markers look like a 'T',"));
-    Screen.tft->println(F("or this '|-', or this '-|' or like an upside down 'T'"));
-    Screen.tft->println(F("Tap markers close to where the two lines cross."));
-    Screen.tft->println();
-    Screen.tft->println(F("After a tap, a WHITE marker will turn RED, signalling you tapped,"));
-    Screen.tft->println(F("A little later it will turn WHITE again. Signalling you need to tap it again."));
-    Screen.tft->println(F("A marker must be tapped 3 times successfully in a row, for accuracy reasons."));
-    Screen.tft->println(F("Then a marker is calibrated and a next marker will turn WHITE."));
-    Screen.tft->println();
-    Screen.tft->println(F("You can tap anywhere and still the marker turns RED... or BLUE."));
-    Screen.tft->println(F("A BLUE marker implies a calibration error and will restart for that marker."));
-    Screen.tft->println(F("Staying BLUE for about 1 second, then the marker becomes WHITE again."));
-    Screen.tft->println();
-    Screen.tft->println(F("After having calibrated all markers, the grid will automatically disappear."));
-    Screen.tft->println(F("And your application will start running. After some time :-)"));
-    Screen.tft->println(F("That's all there is to know..."));
-    Screen.tft->println();
-    Screen.tft->println(F("Ready reading this? Just tap to start calibrating..."));
+    explanation();
 
     //
     // Wait for the touch
@@ -320,337 +327,1407 @@ void Calibrator::drawCalibrationMarkers() {
     drawCalibrationMarker(x, y, RED);
   }
 
-  int16_t x = width >> 1;
-  for (int y = 0; y <= height; y += cellSize) {
-    drawCalibrationMarker(x, y, RED);
-  }
-#endif
+  int16_t x = width >> 1;
+  for (int y = 0; y <= height; y += cellSize) {
+    drawCalibrationMarker(x, y, RED);
+  }
+#endif
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Return the appropriate raw X or Y coordinate.
+ *
+ *  theTouch      raw coordinates to use.
+ *  axis          the axis for which the calibration is going on.
+ *
+ *------------------------------------------------------------------------------------------------*/
+uint16_t Calibrator::getAxisValue(XY* theTouch, char axis) {
+
+    switch (axis) {
+      case 'x':
+      case 'X':
+        return theTouch->x;
+
+      case 'y':
+      case 'Y':
+        return theTouch->y;
+    }
+
+    return 0;
+} 
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  The calibration is a state machine advanced by raw touch samples, see
+ *  sample(). Every sample is handled right away and waits are timed with the
+ *  sample time stamps, so it never blocks. Per marker:
+ *
+ *  - The marker is shown WHITE, a touch turns it RED.
+ *  - While touched, a raw value is accumulated every 50ms.
+ *  - Released, the average is one touch of the marker. After a pause of 500ms
+ *    the marker is shown WHITE again, until it is touched
+ *    CALIBRATION_TOUCHES_NEEDED times.
+ *  - If the touches are MAXIMUM_SPREAD or more apart, or their average does not
+ *    exceed that of the previous marker, the marker turns BLUE for a second
+ *    and its touches start over.
+ *  - Otherwise the next marker follows after a second.
+ *
+ *------------------------------------------------------------------------------------------------*/
+#define CALIBRATOR_IDLE         0         // Not calibrating
+#define CALIBRATOR_EXPLAIN      1         // Explanation shown, waiting for a tap
+#define CALIBRATOR_EXPLAINED    2         // Tapped, waiting for the release
+#define CALIBRATOR_COUNTDOWN    3         // Counting down to the start, a tap postpones it
+#define CALIBRATOR_POSTPONE     4         // Postponed, waiting for the release
+#define CALIBRATOR_TOUCH        5         // Marker shown, waiting for its touch
+#define CALIBRATOR_PRESSED      6         // Marker touched, accumulating raw values
+#define CALIBRATOR_PAUSE        7         // Pausing before showing the marker
+
+#define CALIBRATION_START_DELAY 10        // Seconds counted down before the calibration starts
+#define CALIBRATION_SAMPLES     20        // Maximum number of raw values per touch
+#define CALIBRATION_SAMPLE_TIME 50        // ms between two raw values of a touch
+
+Calibrator* Calibrator::active = nullptr;
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Starts calibrating the TFT without blocking. The raw samples of the Touch
+ *  task are taken over until the calibration is done, so the Touch task must
+ *  be scheduled. Until then the TFT is uncalibrated. The calibrator must
+ *  exist until pDone is called, so do not allocate it on the stack.
+ *
+ *  xCalibrationData      An array with (width/cellSize)+1 elements
+ *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *  pDone                 Called when done, it may delete the calibrator
+ *
+ *  Returns false if another calibration is in progress.
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::start(uint16_t* xCalibrationData, uint16_t* yCalibrationData, void (*pDone)(Calibrator* calibrator)) {
+
+  if (active || Touch.rawSampleSink)
+    return false;
+
+  setCalibrated(false);
+
+  done                = pDone;
+  active              = this;
+  Touch.rawSampleSink = forward;
+
+  restart(xCalibrationData, yCalibrationData);
+  return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Passes the samples of the Touch task to the active calibrator.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::forward(XY* raw, bool pressed, unsigned long now) {
+  if (active)
+    active->sample(raw, pressed, now);
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  True while a calibration is in progress.
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::isCalibrating() {
+  return state != CALIBRATOR_IDLE;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Stops calibrating and gives the Touch samples back. The calibration data
+ *  is incomplete, so the TFT stays uncalibrated.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::cancel() {
+
+  state = CALIBRATOR_IDLE;
+
+  free(meshData);
+  meshData = nullptr;
+
+  if (active == this) {
+    active              = nullptr;
+    Touch.rawSampleSink = nullptr;
+  }
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Shows the explanation and waits for the tap to start.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::restart(uint16_t* xCalibrationData, uint16_t* yCalibrationData) {
+
+  xData = xCalibrationData;
+  yData = yCalibrationData;
+
+  //
+  //  A mesh belongs to the calibration it was measured with. The mesh is
+  //  measured with the axes, not with an affine calibration.
+  //
+  Touch.mesh.clear();
+  Touch.setAffineCalibration(nullptr);
+  Touch.drift.reset();
+
+  explanation();
+  state = CALIBRATOR_EXPLAIN;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Advances the calibration with a raw touch sample.
+ *
+ *  raw        The raw touch coordinates
+ *  pressed    True if touched
+ *  now        The time of the sample in ms
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::sample(XY* raw, bool pressed, unsigned long now) {
+
+  switch (state) {
+
+    case CALIBRATOR_EXPLAIN:
+      if (pressed)
+        state = CALIBRATOR_EXPLAINED;
+      break;
+
+    case CALIBRATOR_EXPLAINED:
+      if (!pressed)
+        announce(now);
+      break;
+
+    //
+    //  Count the seconds down like countDownWait(), a tap postpones the start
+    //
+    case CALIBRATOR_COUNTDOWN:
+      if (pressed) {
+        state = CALIBRATOR_POSTPONE;
+        break;
+      }
+
+      if (now - stateStarted > (unsigned long)(counted + 1) * 1000) {
+        Screen.tft->print(++counted);
+        Screen.tft->print(F(" "));
+      }
+
+      if (counted > CALIBRATION_START_DELAY)
+        startPoints();
+      break;
+
+    case CALIBRATOR_POSTPONE:
+      if (!pressed) {
+        explanation();
+        state = CALIBRATOR_EXPLAIN;
+      }
+      break;
+
+    //
+    //  As it has been touched, redraw the calibration marker.
+    //  As confirmation that the input is recognized.
+    //
+    case CALIBRATOR_TOUCH:
+      if (pressed) {
+        displayXYTouch(raw);
+        drawCalibrationMarker(markerX, markerY, RED);
+
+        sampleSum   = 0;
+        sampleSumY  = 0;
+        sampleCount = 0;
+        accumulate(raw, now);
+        state = CALIBRATOR_PRESSED;
+      }
+      break;
+
+    case CALIBRATOR_PRESSED:
+      if (pressed) {
+        displayXYTouch(raw);
+        if (now - lastSample >= CALIBRATION_SAMPLE_TIME)
+          accumulate(raw, now);
+      }
+      else {
+        released(now);
+      }
+      break;
+
+    case CALIBRATOR_PAUSE:
+      if (now - stateStarted >= pauseTime)
+        showMarker();
+      break;
+  }
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Announces the start of the calibration and starts the count down.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::announce(unsigned long now) {
+
+  Screen.tft->print(F("\nCalibration will start in ")); Screen.tft->print(CALIBRATION_START_DELAY); Screen.tft->println(F(" seconds..."));
+  Screen.tft->println(F("\nTap again to postpone the calibration..."));
+
+  counted      = 0;
+  stateStarted = now;
+  state        = CALIBRATOR_COUNTDOWN;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Starts with the first affine point, if affinePoints is 3 or 5. Otherwise
+ *  with the first marker of the X axis.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::startPoints() {
+
+  Screen.tft->fillScreen(BLACK);
+
+  if (affinePoints != 3 && affinePoints != 5) {
+    draw();
+    startAxis('x');
+    return;
+  }
+
+  #if SHOW_ALL_MARKERS
+  for (uint8_t i = 0; i < affinePoints; i++) {
+    int16_t x;
+    int16_t y;
+    affinePoint(i, &x, &y);
+    drawCalibrationMarker(x, height - y, RED);
+  }
+  #endif
+
+  startAxis('a');
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Starts calibrating an axis with its first marker.
+ *
+ *  pAxis      'x' or 'y', or 'm' for the mesh nodes and 'a' for the affine points
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::startAxis(char pAxis) {
+
+  axis       = pAxis;
+  marker     = 0;
+  prevResult = 0;
+
+  resetMarker();
+  showMarker();
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Shows the marker to touch WHITE. If all markers of the axis are done, it
+ *  persists its data and goes on with the next axis, or finishes.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::showMarker() {
+
+  int16_t x;
+  int16_t y;
+
+  //
+  //  At rotation 0 the normalized Y of the mesh and affine points runs up
+  //  from the bottom
+  //
+  if (axis == 'm') {
+    if (marker >= TOUCH_MESH_NODES) {
+      finishMesh();
+      return;
+    }
+
+    meshNode(marker, &x, &y);
+    y = height - y;
+  }
+  else if (axis == 'a') {
+    if (marker >= affinePoints) {
+      finishAffine();
+      return;
+    }
+
+    affinePoint(marker, &x, &y);
+    y = height - y;
+  }
+  else if (axis == 'x') {
+    if (marker >= getXWSize()) {
+      startAxis('y');
+      return;
+    }
+
+    x = marker * cellSize;
+    y = height >> 1;
+  }
+  else {
+    if (marker >= getYHSize()) {
+      finish();
+      return;
+    }
+
+    x = width >> 1;
+    y = height - marker * cellSize;
+  }
+
+  //
+  // Clip x and y
+  //
+  if (x <= 0)
+    x = 0;
+  else if (x >= width)
+    x = width-1;
+
+  if (y < 0)
+    y = 0;
+  else if (y >= height)
+    y = height-1;
+
+  markerX = x;
+  markerY = y;
+
+  drawCalibrationMarker(markerX, markerY, WHITE);
+  state = CALIBRATOR_TOUCH;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Forgets the touches of the current marker, so they start over.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::resetMarker() {
+
+  touches           = 0;
+  calibrationValue  = 0;
+  minValue          = 0xffff;
+  maxValue          = 0;
+  calibrationValueY = 0;
+  minValueY         = 0xffff;
+  maxValueY         = 0;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Pauses before the marker is shown (again).
+ *
+ *  now        The time of the current sample
+ *  ms         The duration of the pause
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::pause(unsigned long now, uint16_t ms) {
+
+  stateStarted = now;
+  pauseTime    = ms;
+  state        = CALIBRATOR_PAUSE;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Avoid any jitter or disturbance by accumulating the raw value as long as
+ *  the press takes. Up to CALIBRATION_SAMPLES values and avoid an overflow.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::accumulate(XY* raw, unsigned long now) {
+
+  if (sampleCount < CALIBRATION_SAMPLES && sampleSum < 30000 && sampleSumY < 30000) {
+    if (axis == 'm' || axis == 'a') {
+      sampleSum  += raw->x;
+      sampleSumY += raw->y;
+    }
+    else {
+      sampleSum  += getAxisValue(raw, axis);
+    }
+    sampleCount++;
+  }
+
+  lastSample = now;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  The marker is released, evaluate its touch.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::released(unsigned long now) {
+
+  if (axis == 'm' || axis == 'a') {
+    pointReleased(now);
+    return;
+  }
+
+  uint16_t roundedValue = round((float)sampleSum/(float)sampleCount);
+
+  if (roundedValue < minValue)
+    minValue = roundedValue;
+  if (roundedValue > maxValue)
+    maxValue = roundedValue;
+
+  //
+  //  An illegal value, or values more than MAXIMUM_SPREAD apart,
+  //  retry the calibration of the current marker.
+  //
+  if (roundedValue == 0 || (maxValue - minValue) >= MAXIMUM_SPREAD) {
+    drawCalibrationMarker(markerX, markerY, BLUE);
+    resetMarker();
+    pause(now, 1000);
+    return;
+  }
+
+  calibrationValue += roundedValue;
+  touches++;
+
+  //
+  //  Wait 500ms before asking again
+  //
+  if (touches < CALIBRATION_TOUCHES_NEEDED) {
+    pause(now, 500);
+    return;
+  }
+
+  //
+  // The average result of the number of required touches
+  //
+  uint16_t result = round(((float)calibrationValue / (float)CALIBRATION_TOUCHES_NEEDED));
+
+  //
+  //  If the calibration value of this marker <= previous marker
+  //  then this is an error
+  //
+  if (result <= prevResult) {
+    drawCalibrationMarker(markerX, markerY, BLUE);
+    resetMarker();
+    pause(now, 1000);
+    return;
+  }
+
+  if (axis == 'x')
+    xData[marker] = result;
+  else
+    yData[marker] = result;
+
+  prevResult = result;
+  marker++;
+
+  resetMarker();
+  pause(now, 1000);
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  A mesh node or affine point is released, evaluate its touch. Like
+ *  released(), but for both axes and without the ordering check. Once the
+ *  point is touched CALIBRATION_TOUCHES_NEEDED times, the raw average of an
+ *  affine point is kept. For a mesh node its correction is how far the
+ *  normalized average is off from the node.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::pointReleased(unsigned long now) {
+
+  uint16_t roundedX = round((float)sampleSum /(float)sampleCount);
+  uint16_t roundedY = round((float)sampleSumY/(float)sampleCount);
+
+  if (roundedX < minValue)  minValue  = roundedX;
+  if (roundedX > maxValue)  maxValue  = roundedX;
+  if (roundedY < minValueY) minValueY = roundedY;
+  if (roundedY > maxValueY) maxValueY = roundedY;
+
+  if (roundedX == 0 || roundedY == 0 ||
+      (maxValue  - minValue)  >= MAXIMUM_SPREAD ||
+      (maxValueY - minValueY) >= MAXIMUM_SPREAD) {
+    drawCalibrationMarker(markerX, markerY, BLUE);
+    resetMarker();
+    pause(now, 1000);
+    return;
+  }
+
+  calibrationValue  += roundedX;
+  calibrationValueY += roundedY;
+  touches++;
+
+  if (touches < CALIBRATION_TOUCHES_NEEDED) {
+    pause(now, 500);
+    return;
+  }
+
+  XY xy;
+  xy.x = round((float)calibrationValue  / (float)CALIBRATION_TOUCHES_NEEDED);
+  xy.y = round((float)calibrationValueY / (float)CALIBRATION_TOUCHES_NEEDED);
+
+  if (axis == 'a') {
+    affineRaw[2 * marker]     = xy.x;
+    affineRaw[2 * marker + 1] = xy.y;
+    marker++;
+
+    resetMarker();
+    pause(now, 1000);
+    return;
+  }
+
+  //
+  //  Normalized with the axes only, the mesh is cleared
+  //
+  Touch.normalize(&xy);
+
+  int16_t x;
+  int16_t y;
+  meshNode(marker, &x, &y);
+
+  int16_t dx = constrain(x - xy.x, -127, 127);
+  int16_t dy = constrain(y - xy.y, -127, 127);
+
+  meshData[2 * marker]     = dx;
+  meshData[2 * marker + 1] = dy;
+  marker++;
+
+  resetMarker();
+  pause(now, 1000);
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Returns the normalized coordinates of a mesh node, as TouchMesh spreads
+ *  them over the screen, clipped to the screen.
+ *
+ *  index      The node, row by row
+ *  x, y       Its coordinates
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::meshNode(uint8_t index, int16_t* x, int16_t* y) {
+
+  *x = (int32_t)(index % TOUCH_MESH_COLS) * width  / (TOUCH_MESH_COLS - 1);
+  *y = (int32_t)(index / TOUCH_MESH_COLS) * height / (TOUCH_MESH_ROWS - 1);
+
+  if (*x >= width)
+    *x = width - 1;
+  if (*y >= height)
+    *y = height - 1;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Returns the normalized coordinates of an affine point. The points are
+ *  spread over the screen, 10% away from the edges.
+ *
+ *  index      The point
+ *  x, y       Its coordinates
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::affinePoint(uint8_t index, int16_t* x, int16_t* y) {
+
+  //
+  //  In tenths of the width and height
+  //
+  static const uint8_t three[] = { 1, 1,   9, 5,   5, 9 };
+  static const uint8_t five[]  = { 1, 1,   9, 1,   5, 5,   1, 9,   9, 9 };
+
+  const uint8_t* point = (affinePoints == 3 ? three : five) + 2 * index;
+
+  *x = (int32_t)point[0] * width  / 10;
+  *y = (int32_t)point[1] * height / 10;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Fits the affine calibration through the measured points, least squares
+ *  if there are more than 3. Centering the points keeps the float
+ *  calculation accurate. Returns false if the points are degenerate, e.g.
+ *  all on a line.
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::solveAffine(AffineCalibration* affine) {
+
+  float meanRx = 0, meanRy = 0, meanX = 0, meanY = 0;
+
+  for (uint8_t i = 0; i < affinePoints; i++) {
+    int16_t x;
+    int16_t y;
+    affinePoint(i, &x, &y);
+
+    meanRx += affineRaw[2 * i];
+    meanRy += affineRaw[2 * i + 1];
+    meanX  += x;
+    meanY  += y;
+  }
+
+  meanRx /= affinePoints;
+  meanRy /= affinePoints;
+  meanX  /= affinePoints;
+  meanY  /= affinePoints;
+
+  float sxx = 0, sxy = 0, syy = 0;         // Of the raw coordinates
+  float sxu = 0, syu = 0, sxv = 0, syv = 0; // Of the raw with the normalized coordinates
+
+  for (uint8_t i = 0; i < affinePoints; i++) {
+    int16_t x;
+    int16_t y;
+    affinePoint(i, &x, &y);
+
+    float rx = affineRaw[2 * i]     - meanRx;
+    float ry = affineRaw[2 * i + 1] - meanRy;
+    float u  = x - meanX;
+    float v  = y - meanY;
+
+    sxx += rx * rx;
+    sxy += rx * ry;
+    syy += ry * ry;
+    sxu += rx * u;
+    syu += ry * u;
+    sxv += rx * v;
+    syv += ry * v;
+  }
+
+  float det = sxx * syy - sxy * sxy;
+  if (det <= 0.0001 * sxx * syy)
+    return false;
+
+  float xx = (sxu * syy - syu * sxy) / det;
+  float xy = (syu * sxx - sxu * sxy) / det;
+  float yx = (sxv * syy - syv * sxy) / det;
+  float yy = (syv * sxx - sxv * sxy) / det;
+
+  //
+  //  In Q16, the offsets include 0.5 so the shift rounds
+  //
+  affine->xx     = round(xx * 65536.0);
+  affine->xy     = round(xy * 65536.0);
+  affine->x0     = round((meanX - xx * meanRx - xy * meanRy + 0.5) * 65536.0);
+  affine->yx     = round(yx * 65536.0);
+  affine->yy     = round(yy * 65536.0);
+  affine->y0     = round((meanY - yx * meanRx - yy * meanRy + 0.5) * 65536.0);
+  affine->width  = width;
+  affine->height = height;
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  All affine points are calibrated, persist the calibration and make it
+ *  available to the TouchHandler. If the points are degenerate, they are
+ *  calibrated again.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::finishAffine() {
+
+  AffineCalibration affine;
+
+  if (!solveAffine(&affine)) {
+    if (Serial) Serial.println(F("ERROR **** Affine calibration points are degenerate, retrying"));
+    startPoints();
+    return;
+  }
+
+  if (storeRecord(nullptr, nullptr, affinePoints, &affine, nullptr))
+    setCalibrated(true);
+  else {
+    if (Serial) Serial.println(F("ERROR **** TFT calibration not persisted, it is calibrated again at the next start up"));
+  }
+  Screen.tft->fillScreen(BLACK);
+
+  Touch.mesh.clear();
+  Touch.setAffineCalibration(&affine);
+
+  complete();
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  All markers are calibrated, persist the data and make it available to
+ *  the TouchHandler. Then the mesh is calibrated, if requested.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::finish() {
+
+  uint16_t xSize = getXWSize();
+  uint16_t ySize = getYHSize();
+
+  //
+  //  Persisted without a mesh, also if one is calibrated next. If that is
+  //  not completed the axes are still there.
+  //
+  //  Only marked calibrated if persisted, otherwise the next start up
+  //  calibrates again instead of using an older calibration.
+  //
+  if (storeRecord(xData, yData, 0, nullptr, nullptr))
+    setCalibrated(true);
+  else {
+    if (Serial) Serial.println(F("ERROR **** TFT calibration not persisted, it is calibrated again at the next start up"));
+  }
+
+  //
+  // We are done calibrating
+  //
+  Screen.tft->fillScreen(BLACK);
+
+  Touch.setMarkerDistance(cellSize);
+  Touch.setXCalibration(xSize, xData);
+  Touch.setYCalibration(ySize, yData);
+
+  if (meshCalibration && !meshData)
+    meshData = (int8_t*)malloc(2 * TOUCH_MESH_NODES);
+
+  if (meshCalibration && meshData) {
+
+    #if SHOW_ALL_MARKERS
+    for (uint8_t i = 0; i < TOUCH_MESH_NODES; i++) {
+      int16_t x;
+      int16_t y;
+      meshNode(i, &x, &y);
+      drawCalibrationMarker(x, min(height - y, height - 1), RED);
+    }
+    #endif
+
+    startAxis('m');
+    return;
+  }
+
+  complete();
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  All mesh nodes are calibrated, persist the mesh and make it available to
+ *  the TouchHandler.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::finishMesh() {
+
+  if (storeRecord(xData, yData, 0, nullptr, meshData))
+    setCalibrated(true);
+  else {
+    if (Serial) Serial.println(F("ERROR **** TFT calibration mesh not persisted"));
+  }
+
+  Touch.mesh.build(width, height, meshData);
+
+  free(meshData);
+  meshData = nullptr;
+
+  Screen.tft->fillScreen(BLACK);
+  complete();
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  The calibration is done. The Touch samples are given back and pDone is
+ *  called, as the last thing, since it may delete this calibrator.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::complete() {
+
+  state = CALIBRATOR_IDLE;
+
+  if (active == this) {
+    active              = nullptr;
+    Touch.rawSampleSink = nullptr;
+
+    if (done)
+      done(this);
+  }
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Calibrate the entire screen using all markers for the X and Y axis.
+ *  On return the data is captured in the arrays passed as an argument.
+ *  Note that the arrays should be sufficiently large.
+ *
+ *  xCalibrationData      An array with (width/cellSize)+1 elements
+ *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *
+ *------------------------------------------------------------------------------------------------*/
+void Calibrator::calibrate(uint16_t* xCalibrationData, uint16_t* yCalibrationData) {
+
+  //
+  // If already calibrated, then return the persisted calibration data, which is used to
+  // convert the raw touch coordinates into proper screen coordinates if touched.
+  //
+  if (loadCalibration(xCalibrationData, yCalibrationData))
+    return;
+
+  //
+  //  Drive the calibration with samples of its own, until it is done.
+  //  Like start(), but blocking. A persisted calibration that does not fit
+  //  the screen and cell size or that is corrupted, is calibrated again.
+  //
+  setCalibrated(false);
+  restart(xCalibrationData, yCalibrationData);
+
+  while (isCalibrating()) {
+    XY   xy;
+    bool pressed = getRawTouchData(&xy);
+
+    sample(&xy, pressed, millis());
+  }
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Installs the persisted calibration data in the TouchHandler, without any
+ *  user interaction. Nothing is installed and false is returned if the TFT is
+ *  not calibrated, or if no persisted calibration fits the screen and cell
+ *  size and matches its checksum.
+ *
+ *  xCalibrationData      An array with (width/cellSize)+1 elements
+ *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::loadCalibration(uint16_t* xCalibrationData, uint16_t* yCalibrationData) {
+
+  AffineCalibration affine;
+  int8_t            corrections[2 * TOUCH_MESH_NODES];
+
+  if (!isCalibrated())
+    return false;
+
+  //
+  //  A calibration persisted before the record is migrated to it once
+  //
+  if (!loadRecord(xCalibrationData, yCalibrationData, &affine, corrections)) {
+    if (!loadLegacy(xCalibrationData, yCalibrationData))
+      return false;
+
+    recordPoints = 0;
+    recordMesh   = false;
+  }
+
+  Touch.mesh.clear();
+
+  if (recordPoints) {
+    Touch.setAffineCalibration(&affine);
+    return true;
+  }
+
+  Touch.setAffineCalibration(nullptr);
+  Touch.setMarkerDistance(cellSize);
+  Touch.setXCalibration(getXWSize(), xCalibrationData);
+  Touch.setYCalibration(getYHSize(), yCalibrationData);
+
+  if (recordMesh)
+    Touch.mesh.build(width, height, corrections);
+
+  return true;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Adds a byte to a CRC-16/CCITT.
+ *
+ *------------------------------------------------------------------------------------------------*/
+static uint16_t crc16Byte(uint16_t crc, uint8_t value) {
+
+  crc ^= (uint16_t)value << 8;
+  for (uint8_t bit = 0; bit < 8; bit++)
+    crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+
+  return crc;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Adds a 16 bit value to a CRC-16/CCITT, low byte first.
+ *
+ *------------------------------------------------------------------------------------------------*/
+static uint16_t crc16(uint16_t crc, uint16_t value) {
+
+  crc = crc16Byte(crc, value & 0xff);
+  return crc16Byte(crc, value >> 8);
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Appends a value to a calibration record as a varint, 7 bits per byte with
+ *  the high bit set on all but the last. Returns where the next value goes,
+ *  or nullptr if it does not fit before end.
+ *
+ *------------------------------------------------------------------------------------------------*/
+static uint8_t* putVarint(uint8_t* p, const uint8_t* end, uint16_t value) {
+
+  do {
+    if (p >= end)
+      return nullptr;
+
+    *p++   = (value & 0x7f) | (value > 0x7f ? 0x80 : 0);
+    value >>= 7;
+  } while (value);
+
+  return p;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Reads a varint from a calibration record. Returns where the next value
+ *  is, or nullptr if it runs past end.
+ *
+ *------------------------------------------------------------------------------------------------*/
+static const uint8_t* getVarint(const uint8_t* p, const uint8_t* end, uint16_t* value) {
+
+  *value = 0;
+
+  for (uint8_t shift = 0; shift < 21; shift += 7) {
+    if (p >= end)
+      return nullptr;
+
+    uint8_t b = *p++;
+    *value |= (uint16_t)(b & 0x7f) << shift;
+
+    if (!(b & 0x80))
+      return p;
+  }
+
+  return nullptr;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Returns the CRC-16/CCITT of the calibration parameters and data. The
+ *  parameters are included, so data of another screen size never matches.
+ *
+ *  xCalibrationData      An array with (width/cellSize)+1 elements
+ *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *
+ *------------------------------------------------------------------------------------------------*/
+uint16_t Calibrator::checksum(uint16_t* xCalibrationData, uint16_t* yCalibrationData) {
+
+  uint16_t xSize = getXWSize();
+  uint16_t ySize = getYHSize();
+  uint16_t crc   = 0xffff;
+
+  crc = crc16(crc, width);
+  crc = crc16(crc, height);
+  crc = crc16(crc, cellSize);
+  crc = crc16(crc, xSize);
+  crc = crc16(crc, ySize);
+
+  for (uint16_t i = 0; i < xSize; i++)
+    crc = crc16(crc, xCalibrationData[i]);
+
+  for (uint16_t i = 0; i < ySize; i++)
+    crc = crc16(crc, yCalibrationData[i]);
+
+  return crc;
 }
 
 /*--------------------------------------------------------------------------------------------------
  *
- *  Return the appropriate raw X or Y coordinate.
- *
- *  theTouch      raw coordinates to use.
- *  axis          the axis for which the calibration is going on.
+ *  Returns true if no persistent area of the application reaches into the
+ *  calibration block at ADR_TFT_CALIBR_AREA, so it can be written. The areas
+ *  are walked like Dump::listPersistentAreas() does. Otherwise an error is
+ *  printed, and the calibration is not persisted.
  *
  *------------------------------------------------------------------------------------------------*/
-uint16_t Calibrator::getAxisValue(XY* theTouch, char axis) {
+bool Calibrator::areaIsFree() {
 
-    switch (axis) {
-      case 'x':
-      case 'X':
-        return theTouch->x;
+  struct persistentAreaHeader header;
 
-      case 'y':
-      case 'Y':
-        return theTouch->y;
+  for (uint32_t addr = EPR_START_FREE; addr < EPR_END_FREE; addr += header.next) {
+
+    persistentReadHeader(addr + PERSISTENT_AREA_PREFIX_SIZE, &header);
+
+    //
+    //  The end of the list, or a broken one
+    //
+    if (header.next == 0xffff || header.next == 0)
+      break;
+
+    if (header.data != 0xffff && addr + header.next > ADR_TFT_CALIBR_AREA) {
+      if (Serial) Serial.println(F("ERROR **** Persistent areas overlap the TFT calibration, see ADR_TFT_CALIBR_AREA"));
+      return false;
     }
+  }
 
-    return 0;
-} 
+  return true;
+}
 
 /*--------------------------------------------------------------------------------------------------
  *
- *  Calibrate based on the raw touch data coming from getRawTouchData() method.
- *  This data is generated by the onTouchEvent() method. It is available
- *  in the markerRawData class attribute.
+ *  Encodes the calibration record, see loadRecord(). Returns its length in
+ *  bytes, or 0 if it does not fit in CALIBRATION_RECORD_SIZE.
  *
- *  prevResult      The prevResult, which must be smaller then the new marker value
- *  xy              Identifies the marker to be used for this calibration
- *  axis            Contains an 'x' or 'X' or 'y' or 'Y for the x or y-axis calibration
+ *  record                The CALIBRATION_RECORD_SIZE bytes to encode it in
+ *  sequence              Its sequence number
+ *  xCalibrationData      An array with (width/cellSize)+1 elements
+ *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *  points                0 for the axes, 3 or 5 for the affine calibration
+ *  affine                The affine calibration, if points is not 0
+ *  corrections           The mesh, or nullptr if there is none
  *
  *------------------------------------------------------------------------------------------------*/
-uint16_t Calibrator::calibrateMarker(uint16_t prevResult, XY* xy, char axis) {
+uint16_t Calibrator::encodeRecord(uint8_t* record, uint8_t sequence,
+                                  uint16_t* xCalibrationData, uint16_t* yCalibrationData,
+                                  uint8_t points, AffineCalibration* affine, const int8_t* corrections) {
+
+  uint16_t       xSize = getXWSize();
+  uint16_t       ySize = getYHSize();
+  const uint8_t* end   = record + CALIBRATION_RECORD_SIZE - 2;
+
+  if (xSize > 0xff || ySize > 0xff)
+    return 0;
+
+  record[0] = CALIBRATION_RECORD_VERSION;
+  record[1] = sequence;
+  record[2] = width  & 0xff;
+  record[3] = width  >> 8;
+  record[4] = height & 0xff;
+  record[5] = height >> 8;
+  record[6] = cellSize;
+  record[7] = xSize;
+  record[8] = ySize;
+  record[9] = points;
+
+  uint8_t* p = record + 10;
 
   //
-  //  As long as we do not have a valid calibration value,
-  //  keep repeating the calibration of this marker.
+  //  The affine matrix replaces the axes
   //
-  do {
-    //
-    //  Get the marker coordinates
-    //
-    int16_t x = xy->x;
-    int16_t y = xy->y;
+  if (points) {
+    int32_t* matrix = &affine->xx;
+    for (uint8_t i = 0; i < 6; i++)
+      for (uint8_t shift = 0; shift < 32; shift += 8)
+        *p++ = (uint32_t)matrix[i] >> shift;
+  }
 
-    uint16_t markerTouchedCount = 0;
-    uint16_t calibrationValue   = 0;
+  for (uint8_t axis = 0; axis < 2 && p && !points; axis++) {
+    uint16_t* data     = axis ? yCalibrationData : xCalibrationData;
+    uint16_t  size     = axis ? ySize : xSize;
+    uint16_t  previous = 0;
 
     //
-    //  As long as the calibration marker values are too wide apart (min and max values!),
-    //  we keep trying to calibrate the current marker.
+    //  The deltas are small and mostly positive, zigzag keeps the negative
+    //  ones small too
     //
-    uint16_t min = 0xffff;
-    uint16_t max = 0;
-    do {
-    
-      //
-      //  If minimum and maximum of marker coordinate are too much apart,
-      //  give a visual clue and retry the same marker again
-      //
-      if ((max - min ) > MAXIMUM_SPREAD) {
-        drawCalibrationMarker(x, y, BLUE);
-        delay(1000);
-      }
-      min = 0xffff;
-      max = 0;
-
-      //
-      // Reset the touch counter for this marker and the cumulative calibrationValue
-      //
-      markerTouchedCount = 0;
-      calibrationValue   = 0;
+    for (uint16_t i = 0; i < size && p; i++) {
+      int16_t delta = data[i] - previous;
+      p        = putVarint(p, end, (uint16_t)(delta << 1) ^ (uint16_t)(delta >> 15));
+      previous = data[i];
+    }
+  }
 
-      //
-      // Make sure we have the required number of touches per  marker
-      //
-      while (markerTouchedCount < CALIBRATION_TOUCHES_NEEDED) {
-
-        //
-        //  Show same marker as white (again), for the (repeated) touch.
-        //
-        drawCalibrationMarker(x, y, WHITE);
-
-        //
-        // Wait for the touch
-        //
-        while (!getRawTouchData(xy))
-          ;
-
-        //
-        //  Display raw x, y
-        //
-        char s[16] = "";
-        int dX = 0;
-        int dY = 0;
-        Screen.tft->setCursor(dX, dY);
-        Screen.tft->fillRect(dX, dY, 80, 10, BLACK);
-        sprintf(s, "(%4d, %4d)", xy->x, xy->y);
-        Screen.tft->println(s);
+  if (!p || (!points && p + 2 + (corrections ? 2 * TOUCH_MESH_NODES : 0) > end))
+    return 0;
 
-        //
-        //  As it has been touched,
-        //  redraw the calibration marker. 
-        //  As confirmation that the input is recognized.
-        //
-        drawCalibrationMarker(x, y, RED);
-
-        //
-        // Avoid any jitter or disturbance
-        // By accumulating the coordinate as along as the press takes
-        //
-        int counter = 0;
-        uint16_t tmpValue = 0;
-      
-        do {
-          displayXYTouch(xy);
-          if (counter < 20 && tmpValue < 30000) {
-            uint16_t v = getAxisValue(xy, axis);
-            tmpValue  += v;
-            counter++;
-            delay(50);  // Check again over 50ms and avoid getting overflow
-          }
-        }
-        while (getRawTouchData(xy));
+  if (!points) {
+    *p++ = corrections ? TOUCH_MESH_COLS : 0;
+    *p++ = corrections ? TOUCH_MESH_ROWS : 0;
 
-        uint16_t roundedValue = round((float)tmpValue/(float)counter);
+    for (uint8_t i = 0; corrections && i < 2 * TOUCH_MESH_NODES; i++)
+      *p++ = corrections[i];
+  }
 
-        if (roundedValue < min)
-          min = roundedValue;
-        if (roundedValue > max)
-          max = roundedValue;
+  uint16_t crc = 0xffff;
+  for (const uint8_t* q = record; q < p; q++)
+    crc = crc16Byte(crc, *q);
 
-        //
-        //  If illegal value, then force a retry
-        //
-        if(roundedValue == 0) {
-          max = MAXIMUM_SPREAD + 1;
-          min = 0;
-        }
+  *p++ = crc & 0xff;
+  *p++ = crc >> 8;
 
-        //
-        //  If the value is more than MAXIMUM_SPREAD, this triggers an immediate abort.
-        //  And consequently a calibration retry of the current marker.
-        //
-        if ((max - min) >= MAXIMUM_SPREAD) {
-          break;
-        }
+  return p - record;
+}
 
-        calibrationValue += roundedValue;
-        markerTouchedCount++;
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Checks a copy of the calibration record and decodes it, see loadRecord().
+ *  Returns false if it is of another version, does not fit the screen and
+ *  cell size, or does not match its checksum. What it holds is left in
+ *  recordPoints and recordMesh.
+ *
+ *  record                The CALIBRATION_RECORD_SIZE bytes of the copy
+ *  xCalibrationData      Where the X-axis goes, nullptr to only check it
+ *  yCalibrationData      Where the Y-axis goes, nullptr to only check it
+ *  affine                Where the affine calibration goes, or nullptr
+ *  corrections           Where the mesh goes, or nullptr
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::decodeRecord(const uint8_t* record,
+                              uint16_t* xCalibrationData, uint16_t* yCalibrationData,
+                              AffineCalibration* affine, int8_t* corrections) {
+
+  uint16_t       xSize  = getXWSize();
+  uint16_t       ySize  = getYHSize();
+  uint8_t        points = record[9];
+  const uint8_t* end    = record + CALIBRATION_RECORD_SIZE - 2;
+
+  if (record[0] != CALIBRATION_RECORD_VERSION            ||
+      (record[2] | (uint16_t)record[3] << 8) != width    ||
+      (record[4] | (uint16_t)record[5] << 8) != height   ||
+      record[6] != cellSize                              ||
+      record[7] != xSize                                 ||
+      record[8] != ySize                                 ||
+      (points != 0 && points != 3 && points != 5))
+    return false;
+
+  const uint8_t* p    = record + 10;
+  bool           mesh = false;
+
+  if (points) {
+    int32_t matrix[6];
+    for (uint8_t i = 0; i < 6; i++, p += 4)
+      matrix[i] = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+
+    if (affine) {
+      memcpy(&affine->xx, matrix, sizeof(matrix));
+      affine->width  = width;
+      affine->height = height;
+    }
+  }
 
-        delay(500);  // Wait 500ms before asking again.
-      }
+  for (uint8_t axis = 0; axis < 2 && p && !points; axis++) {
+    uint16_t* data     = axis ? yCalibrationData : xCalibrationData;
+    uint16_t  size     = axis ? ySize : xSize;
+    uint16_t  previous = 0;
 
-      //
-      // Keep trying to calibrate the current marker if the spread in calibration values is greater than the MAXIMUM_SPREAD.
-      //
-    } while( (max - min) >= MAXIMUM_SPREAD);
-  
-    //
-    // The average result of the number of required touches
-    //
-    uint16_t result = round(((float)calibrationValue / (float)CALIBRATION_TOUCHES_NEEDED));
+    for (uint16_t i = 0; i < size && p; i++) {
+      uint16_t zigzag;
+      p = getVarint(p, end, &zigzag);
 
-    //
-    //  If the calibration value of this marker < previous marker
-    //  then this is an error
-    //
-    if (result <= prevResult) {
-       drawCalibrationMarker(x, y, BLUE);
-       delay(1000);
+      previous += (zigzag >> 1) ^ -(zigzag & 1);
+      if (data)
+        data[i] = previous;
     }
-    else {
-      return result;
+  }
+
+  if (p && !points) {
+    if (p + 2 > end)
+      return false;
+
+    mesh = p[0] != 0;
+    if (mesh && (p[0] != TOUCH_MESH_COLS || p[1] != TOUCH_MESH_ROWS || p + 2 + 2 * TOUCH_MESH_NODES > end))
+      return false;
+
+    p += 2;
+    if (mesh) {
+      if (corrections)
+        memcpy(corrections, p, 2 * TOUCH_MESH_NODES);
+      p += 2 * TOUCH_MESH_NODES;
     }
   }
-  while (1);  // An error occurred, try again if we end up here.
+
+  if (!p)
+    return false;
+
+  uint16_t crc = 0xffff;
+  for (const uint8_t* q = record; q < p; q++)
+    crc = crc16Byte(crc, *q);
+
+  if ((p[0] | (uint16_t)p[1] << 8) != crc) {
+    if (Serial) Serial.println(F("ERROR **** EEPROM TFT calibration record checksum mismatch"));
+    return false;
+  }
+
+  recordPoints = points;
+  recordMesh   = mesh;
+
+  return true;
 }
 
 /*--------------------------------------------------------------------------------------------------
  *
- *  Calibrate the screen on a specific marker.
+ *  Reads the calibration record. It is persisted twice, at
+ *  ADR_TFT_CALIBR_RECORD and CALIBRATION_RECORD_SIZE bytes further, and the
+ *  valid copy with the later sequence number is current. Normally that takes
+ *  a single persistentRead, see findRecord(). Each copy is:
+ *
+ *    uint8_t   CALIBRATION_RECORD_VERSION
+ *    uint8_t   Sequence number, incremented by every store
+ *    uint16_t  Screen width
+ *    uint16_t  Screen height
+ *    uint8_t   Cell size
+ *    uint8_t   Number of X-axis markers
+ *    uint8_t   Number of Y-axis markers
+ *    uint8_t   Affine points, 0 if calibrated with the axes
+ *
+ *  Then for an affine calibration:
  *
- *  prevResult      The previous marker value
- *  x               The X-center coordinate of the marker used
- *  y               The Y-center coordinate of the marker used 
- *  axis            contains an 'x' or 'X' or 'y' or 'Y' depending on the axis to calibrate
+ *    int32_t   The matrix xx, xy, x0, yx, yy, y0 in Q16
+ *
+ *  Or for the axes:
+ *
+ *    varint    The X-axis, then the Y-axis markers. Each is the zigzag
+ *              encoded difference with the previous marker, or with 0.
+ *    uint8_t   TOUCH_MESH_COLS, or 0 if there is no mesh
+ *    uint8_t   TOUCH_MESH_ROWS, or 0
+ *    int8_t    The X and Y correction in pixels per mesh node, row by row
+ *
+ *  And at last:
+ *
+ *    uint16_t  CRC-16/CCITT of all of the above
+ *
+ *  All values are little endian. Returns false if there is no valid copy for
+ *  this screen and cell size. recordPoints and recordMesh tell what the
+ *  current copy holds.
+ *
+ *  xCalibrationData      An array with (width/cellSize)+1 elements, or nullptr
+ *  yCalibrationData      An array with (height/cellSize)+1 elements, or nullptr
+ *  affine                Where the affine calibration goes, or nullptr
+ *  corrections           2 * TOUCH_MESH_NODES for the mesh, or nullptr
  *
  *------------------------------------------------------------------------------------------------*/
-uint16_t Calibrator::calibrate(uint16_t prevResult, int16_t x, int16_t y, char axis) {
-
-    //
-    // Clip x
-    //
-    if (x <= 0)
-      x = 0;
-    else if (x >= width)
-      x = width-1;
+bool Calibrator::loadRecord(uint16_t* xCalibrationData, uint16_t* yCalibrationData,
+                            AffineCalibration* affine, int8_t* corrections) {
 
-    //
-    // Clip y
-    //
-    if (y < 0)
-      y = 0;
-    else if (y >= height)
-      y = height-1;
+  uint8_t record[CALIBRATION_RECORD_SIZE];
 
-    //
-    //  Gather calibration data
-    //
-    XY xy;
-    xy.x = x;
-    xy.y = y;
+  if (!findRecord(record))
+    return false;
 
-    uint16_t data = calibrateMarker(prevResult, &xy, axis);
-    delay(1000);
+  decodeRecord(record, xCalibrationData, yCalibrationData, affine, corrections);
 
-    return data;
+  return true;
 }
 
 /*--------------------------------------------------------------------------------------------------
  *
- *  Calibrate the entire screen using all markers for the X and Y axis.
- *  On return the data is captured in the arrays passed as an argument.
- *  Note that the arrays should be sufficiently large.
+ *  Reads the current copy of the calibration record into record and sets
+ *  recordCopy and recordSequence. Only the sequence numbers of both copies
+ *  are read to pick the later one, that copy is then read and checked. The
+ *  other copy is only read if it is not valid, e.g. after an interrupted
+ *  write. Returns false if neither copy is valid.
  *
- *  xCalibrationData      An array with (width/cellSize)+1 elements
- *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *  record                CALIBRATION_RECORD_SIZE bytes
  *
  *------------------------------------------------------------------------------------------------*/
-void Calibrator::calibrate(uint16_t* xCalibrationData, uint16_t* yCalibrationData) {
+bool Calibrator::findRecord(uint8_t* record) {
 
-  //
-  //  Check if some calibration parameters have changed.
-  //  If so recalibration will be triggered.
-  //
-  checkParameters();
-
-  uint16_t      xSize      = EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S);
-  uint16_t      xSizeBytes = xSize * sizeof(uint16_t);
- 
-  uint16_t      ySize      = EEPROM_RD_INT(EPR16_TFT_CALIBR_Y_S);
-  uint16_t      ySizeBytes = ySize * sizeof(uint16_t);
+  uint8_t sequence0 = EEPROM_RD_BYTE(ADR_TFT_CALIBR_RECORD + 1);
+  uint8_t sequence1 = EEPROM_RD_BYTE(ADR_TFT_CALIBR_RECORD + CALIBRATION_RECORD_SIZE + 1);
 
   //
-  // If already calibrated, then return the persisted calibration data, which is used to
-  // convert the raw touch coordinates into proper screen coordinates if touched.
+  //  The sequence number wraps around, the later one is at most 127 ahead
   //
-  if (isCalibrated()) {
-    //
-    //  Read in the earlier persisted calibration data
-    //
-    persistentRead(ADR_TFT_CALIBR_X, (char*)xCalibrationData, xSizeBytes);
-    persistentRead(ADR_TFT_CALIBR_Y, (char*)yCalibrationData, ySizeBytes);
+  uint8_t later = (int8_t)(sequence1 - sequence0) > 0 ? 1 : 0;
 
-    //
-    // Make the calibration data available to the TouchHandler
-    //
-    Touch.setMarkerDistance(cellSize);
-    Touch.setXCalibration(xSize, xCalibrationData);
-    Touch.setYCalibration(ySize, yCalibrationData);     
+  for (uint8_t i = 0; i < 2; i++) {
+    uint8_t copy = i ? 1 - later : later;
 
-    //
-    // And we are ready
-    //
-    return;
+    persistentRead(ADR_TFT_CALIBR_RECORD + copy * CALIBRATION_RECORD_SIZE, (char*)record, CALIBRATION_RECORD_SIZE);
+
+    if (decodeRecord(record, nullptr, nullptr, nullptr, nullptr)) {
+      recordCopy     = copy;
+      recordSequence = record[1];
+      return true;
+    }
   }
 
-  //
-  //  Before starting explain the calibration procedure
-  //
-  explain();
+  recordCopy = -1;
+
+  return false;
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Persists the calibration record, see loadRecord(). It is written over the
+ *  copy that is not current, so if writing is interrupted the current copy
+ *  is still used. Then it is read back and checked. The calibration
+ *  persisted before the record is invalidated first, so neither a corrupted
+ *  record nor a failed store is ever replaced by it. Returns false if the
+ *  record was not persisted.
+ *
+ *  xCalibrationData      An array with (width/cellSize)+1 elements
+ *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *  points                0 for the axes, 3 or 5 for the affine calibration
+ *  affine                The affine calibration, if points is not 0
+ *  corrections           The mesh, or nullptr if there is none
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::storeRecord(uint16_t* xCalibrationData, uint16_t* yCalibrationData,
+                             uint8_t points, AffineCalibration* affine, const int8_t* corrections) {
 
   //
-  //  Draw the calibration grid
+  //  Without markers legacyFits() never matches again, also if storing
+  //  fails. The calibration is then not loaded at all instead of a stale one.
   //
-  draw();
+  if (EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S) != 0)
+    EEPROM_WR_INT(EPR16_TFT_CALIBR_X_S, 0);
+
+  if (!areaIsFree())
+    return false;
 
   //
+  //  The current copy is only read to know the other one, the same
+  //  buffer then holds the new record
   //
-  //  Calibrate the X-axis
-  //
-  int y = height >> 1;
-  uint16_t result = 0;
-  for (int x = 0, xCalibration = 0; x <= width; x += cellSize, xCalibration++) {
-    result = calibrate(result, x, y, 'x');
-    xCalibrationData[xCalibration] = result;
+  uint8_t  record[CALIBRATION_RECORD_SIZE];
+  uint8_t  sequence = findRecord(record) ? recordSequence + 1 : 1;
+  uint16_t length   = encodeRecord(record, sequence, xCalibrationData, yCalibrationData,
+                                   points, affine, corrections);
+
+  if (!length) {
+    if (Serial) Serial.println(F("ERROR **** TFT calibration record does not fit, increase CALIBRATION_RECORD_SIZE"));
+    return false;
   }
 
-  //
-  //  Persist the X-axis calibration data in EEPROM
-  //
-  persistentStore(ADR_TFT_CALIBR_X, (unsigned char*)xCalibrationData, xSizeBytes);
+  uint8_t  copy    = recordCopy == 0 ? 1 : 0;
+  uint16_t address = ADR_TFT_CALIBR_RECORD + copy * CALIBRATION_RECORD_SIZE;
 
-  //
-  //  Calibrate the Y-axis
-  //
-  int x = width >> 1;
-  result = 0;
-  for (int y = height, yCalibration = 0; y >= 0; y -= cellSize, yCalibration++) {
-    result = calibrate(result, x, y, 'y');
-    yCalibrationData[yCalibration] = result;
+  persistentStore(address, record, length);
+
+  for (uint16_t i = 0; i < length; i++) {
+    if (EEPROM_RD_BYTE(address + i) != record[i]) {
+      if (Serial) Serial.println(F("ERROR **** EEPROM write failure: TFT calibration record"));
+      return false;
+    }
   }
 
-  //
-  //  Persist the Y-axis calibration data in EEPROM
-  //
-  persistentStore(ADR_TFT_CALIBR_Y, (unsigned char*)yCalibrationData, ySizeBytes);
+  recordCopy     = copy;
+  recordSequence = record[1];
 
-  //
-  // We are done calibrating
-  //
-  setCalibrated(true);
-  Screen.tft->fillScreen(BLACK);
+  return true;
+}
 
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Returns true if the calibration persisted before the calibration record,
+ *  in separate EEPROM cells, fits the screen and cell size.
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::legacyFits() {
 
-  //
-  // Now make the calibration data available to the TouchHandler
-  //
-  Touch.setMarkerDistance(cellSize);
-  Touch.setXCalibration(xSize, xCalibrationData);
-  Touch.setYCalibration(ySize, yCalibrationData);     
+  return EEPROM_RD_INT(EPR16_TFT_X_W)        == width       &&
+         EEPROM_RD_INT(EPR16_TFT_Y_H)        == height      &&
+         EEPROM_RD_BYTE(EPR8_CELL_S)         == cellSize    &&
+         EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S) == getXWSize() &&
+         EEPROM_RD_INT(EPR16_TFT_CALIBR_Y_S) == getYHSize();
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Reads the calibration persisted before the calibration record and
+ *  persists it as a record. From then on the record is used. Those cells
+ *  have no checksum, so the calibration is only used if it fits and the
+ *  markers of both axes increase, like calibrating them requires.
+ *
+ *  xCalibrationData      An array with (width/cellSize)+1 elements
+ *  yCalibrationData      An array with (height/cellSize)+1 elements
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool Calibrator::loadLegacy(uint16_t* xCalibrationData, uint16_t* yCalibrationData) {
+
+  if (!legacyFits())
+    return false;
+
+  persistentRead(ADR_TFT_CALIBR_X, (char*)xCalibrationData, getXWSize() * sizeof(uint16_t));
+  persistentRead(ADR_TFT_CALIBR_Y, (char*)yCalibrationData, getYHSize() * sizeof(uint16_t));
+
+  for (uint8_t axis = 0; axis < 2; axis++) {
+    uint16_t* data     = axis ? yCalibrationData : xCalibrationData;
+    uint16_t  size     = axis ? getYHSize() : getXWSize();
+    uint16_t  previous = 0;
+
+    for (uint16_t i = 0; i < size; i++) {
+      if (data[i] <= previous || data[i] == 0xffff)
+        return false;
+      previous = data[i];
+    }
+  }
+
+  if (storeRecord(xCalibrationData, yCalibrationData, 0, nullptr, nullptr)) {
+    if (Serial) Serial.println(F("INFO **** Migrated the TFT calibration to the calibration record"));
+  }
+
+  return true;
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -749,124 +1826,22 @@ void Calibrator::setCalibrated(bool b) {
  *  - Number of calibration X-axis makers
  *  - Number of calibration Y-axis makers
  *
- *  If so a recalibration will be triggered 
+ *  The parameters are persisted with the calibration, in the calibration
+ *  record or in the cells used before it. If neither fits, the TFT is set
+ *  uncalibrated and true is returned, so a recalibration will be triggered.
  *
  *------------------------------------------------------------------------------------------------*/
 bool Calibrator::checkParameters() {
 
-  //
-  //  Check if the screen width or height have changed
-  //
-  uint16_t eepromWidth    = EEPROM_RD_INT(EPR16_TFT_X_W);
-  uint16_t eepromHeight   = EEPROM_RD_INT(EPR16_TFT_Y_H);
-
-  uint8_t  eepromCellSize = EEPROM_RD_BYTE(EPR8_CELL_S);
-
-  uint16_t xSize          = (width  / cellSize) + 1;
-  uint16_t ySize          = (height / cellSize) + 1;
-  uint16_t eepromXSize    = EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S);
-  uint16_t eepromYSize    = EEPROM_RD_INT(EPR16_TFT_CALIBR_Y_S);
-
-  //
-  //  If some parameters have changed
-  //
-  if ( eepromWidth    != width    ||
-       eepromHeight   != height   ||
-       eepromCellSize != cellSize ||
-       eepromXSize    != xSize    ||
-       eepromYSize    != ySize) {
-
-    //
-    //  Yes some have changed, so we need to recalibrate the screen
-    //
-    if (isCalibrated()) {
-      setCalibrated(false);	// Set, so we recalibrate
-    }
-
-    //
-    //  Persist the screen width, complain if EEPROM doesn't work
-    // 
-    if (eepromWidth != width) {
-      EEPROM_WR_INT(EPR16_TFT_X_W, width);
-
-      if (EEPROM_RD_INT(EPR16_TFT_X_W) != width) {
-        if (Serial) Serial.println(F("ERROR **** EEPROM write failure: TFT screen width "));
-      }
-      else {
-        if (Serial) {
-          Serial.print(F("INFO **** Stored TFT Screen width: ")); Serial.println(width);
-        }
-      }
-    }        
-
-    //
-    // Persist the screen height, complain if the EEPROM doesn't work
-    //
-    if (eepromHeight != height) {
-      EEPROM_WR_INT(EPR16_TFT_Y_H, height);
-
-      if (EEPROM_RD_INT(EPR16_TFT_Y_H) != height) {
-        if (Serial) Serial.println(F("ERROR **** EEPROM write failure: TFT screen height "));
-      }
-      else {
-        if (Serial) {
-          Serial.print(F("INFO **** Stored TFT Screen height: ")); Serial.println(height);
-        }
-      }
-    }        
-
-    //
-    //  Remember the cell size if it differs
-    //
-    if (cellSize != eepromCellSize) {
-      EEPROM_WR_BYTE(EPR8_CELL_S, cellSize);
-
-      if (EEPROM_RD_BYTE(EPR8_CELL_S) != cellSize) {
-        if (Serial) Serial.println(F("ERROR **** EEPROM write failure: calibration cell size"));
-      }
-      else {
-        if (Serial) {
-          Serial.print(F("INFO **** Stored calibration cell size: ")); Serial.println(cellSize);
-        }
-      }
-    }
-
-    //
-    //  Remember the X-axis number of calibration points differs
-    //
-    if (eepromXSize != xSize) {
-      EEPROM_WR_INT(EPR16_TFT_CALIBR_X_S, xSize);
-
-      if (EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S) != xSize) {
-        if (Serial) Serial.println(F("ERROR **** EEPROM write failure: Number of X-axis markers"));
-      }
-      else {
-        if (Serial) {
-          Serial.print(F("INFO **** Stored number of X-axis markers: ")); Serial.println(xSize);
-        }
-      }
-   }
-
-    //
-    //  Remember the Y-axis number of calibration points differs
-    //
-    if (eepromYSize != ySize) {
-      EEPROM_WR_INT(EPR16_TFT_CALIBR_Y_S, ySize);
+  if (!isCalibrated()                                    ||
+      loadRecord(nullptr, nullptr, nullptr, nullptr)     ||
+      legacyFits())
+    return false;
 
-      if (EEPROM_RD_INT(EPR16_TFT_CALIBR_Y_S) != ySize) {
-        if (Serial) Serial.println(F("ERROR **** EEPROM write failure: Number of Y-axis markers"));
-      }
-      else {
-        if (Serial) {
-          Serial.print(F("INFO **** Stored number of Y-axis markers: ")); Serial.println(ySize);
-        }
-      }
-    }
-
-    return true;
-  }
+  if (Serial) Serial.println(F("INFO **** TFT calibration parameters changed"));
+  setCalibrated(false);
 
-  return false;
+  return true;
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -998,50 +1973,34 @@ void Calibrator::eepromData(bool b) {
   bool virgin = isPersistentStorageVirgin();
   if (!virgin) {
     uint8_t rot = Screen.tft->getRotation();
-    Screen.tft->setRotation(1);
+    Screen.setRotation(1);
     Screen.tft->println(F("\nEEPROM data areas:"));
 
-    Screen.tft->println(F("\n      EPR16_TFT_X_W (screen width):\n"));
-    dumpScreen.dumpEeprom(EPR16_TFT_X_W, 2);
-    Screen.tft->fillScreen(BLACK);
-    Screen.tft->setCursor(0,0);
-
-    Screen.tft->println(F("\n      EPR16_TFT_Y_H (screen height):\n"));            // Contains 16 bit screen height
-    dumpScreen.dumpEeprom(EPR16_TFT_Y_H, 2);
-    Screen.tft->fillScreen(BLACK);
-    Screen.tft->setCursor(0,0);
- 
     Screen.tft->println(F("\n      EPR8_TFT_CALIBRATED (0 if not calibrated yet, non-zero otherwise):\n")); // Contains 0 if not calibrated yet, non-zero otherwise
     dumpScreen.dumpEeprom(EPR8_TFT_CALIBRATED, 1);
     Screen.tft->fillScreen(BLACK);
     Screen.tft->setCursor(0,0);
 
-    Screen.tft->println(F("\n      EPR8_CELL_S (Cell size used to calibrate):\n")); // Cell size used to calibrate
-    dumpScreen.dumpEeprom(EPR8_CELL_S, 1);
-    Screen.tft->fillScreen(BLACK);
-    Screen.tft->setCursor(0,0);
-
-    Screen.tft->print(F("\nEPR16_TFT_CALIBR_X_S (X-Axis calibration data size in # markers uint16_t): ")); Screen.tft->println(EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S)); Screen.tft->println(); // Calibration data size in bytes for the X-axis 
-    dumpScreen.dumpEeprom(EPR16_TFT_CALIBR_X_S, 2);
-    Screen.tft->fillScreen(BLACK);
-    Screen.tft->setCursor(0,0);
- 
-    Screen.tft->print(F("\nEPR16_TFT_CALIBR_Y_S (Y-Axis calibration data size in # markers uint16_t): ")); Screen.tft->println(EEPROM_RD_INT(EPR16_TFT_CALIBR_Y_S)); Screen.tft->println();   // Calibration data size in bytes for the Y axis
-    dumpScreen.dumpEeprom(EPR16_TFT_CALIBR_Y_S, 2);
-    Screen.fillScreen(BLACK);
-    Screen.tft->setCursor(0,0);
+    //
+    //  The calibration itself is in the record, see loadRecord()
+    //
+    loadRecord(nullptr, nullptr, nullptr, nullptr);
 
-    Screen.tft->print(F("\n      &ADR_TFT_CALIBR_X (X-axis calibration data)= 0x")); Screen.tft->print(ADR_TFT_CALIBR_X, HEX); Screen.tft->print(F(", size: ")); Screen.tft->print(sizeof(uint16_t) * EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S)); Screen.tft->println(F(" bytes\n"));
-    dumpScreen.dumpEeprom(ADR_TFT_CALIBR_X, EEPROM_RD_INT(EPR16_TFT_CALIBR_X_S) * sizeof(uint16_t));
-    Screen.tft->fillScreen(BLACK);
-    Screen.tft->setCursor(0,0);
+    for (uint8_t copy = 0; copy < 2; copy++) {
+      uint16_t address = ADR_TFT_CALIBR_RECORD + copy * CALIBRATION_RECORD_SIZE;
 
-    Screen.tft->print(F("\n      &ADR_TFT_CALIBR_Y (Y-axis calibration data)= 0x")); Screen.tft->print(ADR_TFT_CALIBR_Y, HEX); Screen.tft->print(F(", size: ")); Screen.tft->print(sizeof(uint16_t) * EEPROM_RD_INT(EPR16_TFT_CALIBR_Y_S)); Screen.tft->println(F(" bytes\n"));
-    dumpScreen.dumpEeprom(ADR_TFT_CALIBR_Y, EEPROM_RD_INT(EPR16_TFT_CALIBR_Y_S) * sizeof(uint16_t));
-    Screen.tft->fillScreen(BLACK);
-    Screen.tft->setCursor(0,0);
+      Screen.tft->print(F("\n      &ADR_TFT_CALIBR_RECORD (calibration record, copy ")); Screen.tft->print(copy); Screen.tft->print(F(")= 0x")); Screen.tft->print(address, HEX); Screen.tft->print(F(", size: ")); Screen.tft->print(CALIBRATION_RECORD_SIZE); Screen.tft->println(F(" bytes"));
+      if (copy == recordCopy) {
+        Screen.tft->print(F("      Current, sequence: ")); Screen.tft->print(recordSequence); Screen.tft->print(F(", holds: "));
+        Screen.tft->println(recordPoints ? F("affine calibration") : (recordMesh ? F("axes and mesh") : F("axes")));
+      }
+      Screen.tft->println();
+      dumpScreen.dumpEeprom(address, CALIBRATION_RECORD_SIZE);
+      Screen.tft->fillScreen(BLACK);
+      Screen.tft->setCursor(0,0);
+    }
 
-    Screen.tft->setRotation(rot);
+    Screen.setRotation(rot);
   }
 }
 
@@ -1104,7 +2063,7 @@ void Calibrator::diagnostics() {
   for (int r=0; r < 1; r++) {
  
     Screen.tft->fillScreen(BLACK);
-    Screen.tft->setRotation(r);
+    Screen.setRotation(r);
     Screen.tft->setCursor(0,0);
     Screen.tft->print(F("Screen WxH: ")); Screen.tft->print(Screen.tft->width()); Screen.tft->print(F("x"));Screen.tft->println(Screen.tft->height());
     Screen.tft->print(F("Rotation: ")); Screen.tft->println(r);
@@ -1157,7 +2116,7 @@ void Calibrator::diagnostics() {
   //  Test screen coordinates
   //
   Screen.tft->fillScreen(BLACK);
-  Screen.tft->setRotation(0);
+  Screen.setRotation(0);
   Screen.tft->setCursor(0,0);
   Screen.tft->println(F("Tap to enter \nSCREEN X,Y tapping mode..."));
   if (Touch.tapOrTimeout((unsigned long)3000)) {
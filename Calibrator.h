@@ -47,6 +47,27 @@
 #ifndef CALIBRATOR_h
 #define CALIBRATOR_h
 
+#define AFFINE_MAX_POINTS     5               // Maximum number of affine calibration points
+
+#define CALIBRATION_RECORD_VERSION 1          // Version of the calibration record format
+
+#ifndef CALIBRATION_RECORD_SIZE
+#define CALIBRATION_RECORD_SIZE 176           // Bytes of each of the two copies of the calibration record
+#endif
+
+//
+//  Besides the EPR16_TFT_* cells of TerraBox_Persistence, the calibration
+//  uses one block of EEPROM, by default at the end of the free area. The
+//  persistent areas of the application must end below it, see areaIsFree().
+//
+#define TFT_CALIBR_AREA_SIZE  (2 * CALIBRATION_RECORD_SIZE)
+
+#ifndef ADR_TFT_CALIBR_AREA
+#define ADR_TFT_CALIBR_AREA   (EPR_END_FREE - TFT_CALIBR_AREA_SIZE)  // Start of the calibration block
+#endif
+
+#define ADR_TFT_CALIBR_RECORD (ADR_TFT_CALIBR_AREA)   // The calibration record, see loadRecord()
+
 class Calibrator : public Widget {
 
   private:
@@ -57,6 +78,44 @@ class Calibrator : public Widget {
     uint16_t* xMarkers = nullptr;
     uint16_t* yMarkers = nullptr;
 
+    //
+    //  State of the calibration in progress, see sample()
+    //
+    uint8_t       state            = 0;            // What the calibration is waiting for
+    unsigned long stateStarted     = 0;            // When the current state started
+    uint16_t      pauseTime        = 0;            // ms to pause before showing the marker
+    uint16_t      counted          = 0;            // Seconds counted down before starting
+    char          axis             = 'x';          // The axis being calibrated
+    uint16_t      marker           = 0;            // Index of the marker being calibrated
+    int16_t       markerX          = 0;            // Its screen coordinates
+    int16_t       markerY          = 0;
+    uint16_t      prevResult       = 0;            // Raw value of the previous marker
+    uint16_t      touches          = 0;            // Successful touches of the current marker
+    uint16_t      calibrationValue = 0;            // Sum of their raw values
+    uint16_t      minValue         = 0xffff;       // Their minimum and maximum raw value
+    uint16_t      maxValue         = 0;
+    uint16_t      sampleSum        = 0;            // Raw values of the touch in progress
+    uint16_t      sampleCount      = 0;
+    uint16_t      calibrationValueY = 0;           // For the mesh the same for the raw Y values
+    uint16_t      minValueY        = 0xffff;
+    uint16_t      maxValueY        = 0;
+    uint16_t      sampleSumY       = 0;
+    int8_t*       meshData         = nullptr;      // Corrections of the mesh nodes measured so far
+    int16_t       affineRaw[2 * AFFINE_MAX_POINTS]; // Raw X and Y of the affine points measured so far
+    int8_t        recordCopy       = -1;           // The current copy of the calibration record, -1 none
+    uint8_t       recordSequence   = 0;            // Its sequence number
+    uint8_t       recordPoints     = 0;            // Its affine points, 0 if it holds the axes
+    bool          recordMesh       = false;        // It holds a mesh
+    unsigned long lastSample       = 0;            // When the last one was added
+    uint16_t*     xData            = nullptr;      // Where the calibration data goes
+    uint16_t*     yData            = nullptr;
+    void          (*done)(Calibrator* calibrator) = nullptr;
+
+    static Calibrator* active;                     // The calibrator getting the Touch samples
+    static void   forward(XY* raw,                 // Passes the Touch samples to the active calibrator
+                          bool pressed,
+                          unsigned long now);
+
     void drawGrid();                               // Draw the entire grid of calibration markers
     void drawCalibrationMarker(                    // Draw a calibration marker at the indicated x, y
                             int16_t  x, 
@@ -66,15 +125,58 @@ class Calibrator : public Widget {
 
     uint16_t getAxisValue(   XY*     theTouch,     // Get the specific data either raw x or y position 
                              char    axis);
-    uint16_t calibrateMarker(
-                             uint16_t prevResult,  // Get raw calibration data for a specific x, y position
-                             XY*     xy,         
-                             char    axis);
-    uint16_t calibrate(
-                             uint16_t prevResult,  // Get raw calibration data for the x or y position
-                             int16_t x,            
-                             int16_t y, 
-                             char    axis);
+
+    void explanation();                            // Print the explanation of the procedure
+    void announce(unsigned long now);              // Announce the start and count down
+    void restart(uint16_t* xCalibrationData,       // Start with the explanation
+                 uint16_t* yCalibrationData);
+    void startAxis(char pAxis);                    // Start with the first marker of an axis
+    void showMarker();                             // Show the marker to tap, or go on to the next axis
+    void resetMarker();                            // Forget the touches of the current marker
+    void pause(unsigned long now, uint16_t ms);    // Pause before showing the marker again
+    void accumulate(XY* raw, unsigned long now);   // Add a sample of the touch in progress
+    void released(unsigned long now);              // Evaluate the touch of the marker
+    void pointReleased(unsigned long now);         // Same for a mesh node or affine point
+    void meshNode(uint8_t index,                   // Normalized coordinates of a mesh node
+                  int16_t* x,
+                  int16_t* y);
+    void affinePoint(uint8_t index,                // Normalized coordinates of an affine point
+                     int16_t* x,
+                     int16_t* y);
+    bool solveAffine(AffineCalibration* affine);   // Least squares fit of the affine points
+    void finishAffine();                           // Persist and install the affine calibration
+    void startPoints();                            // Start with the affine points or the axes
+    void finish();                                 // Persist and install the calibration data
+    void finishMesh();                             // Persist and install the mesh
+    void complete();                               // Give the Touch samples back and call back
+
+    bool areaIsFree();                             // No persistent area overlaps the calibration block
+
+    uint16_t encodeRecord(uint8_t* record,         // Encode the calibration record, 0 if it does not fit
+                          uint8_t sequence,
+                          uint16_t* xCalibrationData,
+                          uint16_t* yCalibrationData,
+                          uint8_t points,
+                          AffineCalibration* affine,
+                          const int8_t* corrections);
+    bool decodeRecord(const uint8_t* record,       // Check and decode a copy of the calibration record
+                      uint16_t* xCalibrationData,
+                      uint16_t* yCalibrationData,
+                      AffineCalibration* affine,
+                      int8_t* corrections);
+    bool loadRecord(uint16_t* xCalibrationData,    // Read the current copy of the calibration record
+                    uint16_t* yCalibrationData,
+                    AffineCalibration* affine,
+                    int8_t* corrections);
+    bool findRecord(uint8_t* record);              // Read and check the current copy of the record
+    bool storeRecord(uint16_t* xCalibrationData,   // Persist the calibration record in the other copy
+                     uint16_t* yCalibrationData,
+                     uint8_t points,
+                     AffineCalibration* affine,
+                     const int8_t* corrections);
+    bool legacyFits();                             // The calibration persisted before the record fits
+    bool loadLegacy(uint16_t* xCalibrationData,    // Read it and migrate it to the record
+                    uint16_t* yCalibrationData);
 
   public:
     Calibrator(Widget* parent, uint16_t pWidth, uint16_t pHeight, uint16_t pCellSize);
@@ -89,6 +191,19 @@ class Calibrator : public Widget {
     void redraw();                                    // Redraws the calibration grid
     void calibrate(uint16_t* xCalibrationData,        // Fill arrays with calibration data
                    uint16_t* yCalibrationData);       // If uncalibrated or recalibration is desired it calibrates first
+    bool start(uint16_t* xCalibrationData,            // Calibrate with the Touch samples, without blocking
+               uint16_t* yCalibrationData,
+               void (*pDone)(Calibrator* calibrator) = nullptr);
+    void sample(XY* raw, bool pressed,                // Advance the calibration with a raw sample
+                unsigned long now);
+    bool isCalibrating();                             // True while a calibration is in progress
+    void cancel();                                    // Stop calibrating, the TFT stays uncalibrated
+    bool loadCalibration(uint16_t* xCalibrationData,  // Install the persisted calibration data, if valid
+                         uint16_t* yCalibrationData);
+    bool meshCalibration = false;                     // Also calibrate the 2D mesh after the axes
+    uint8_t affinePoints = 0;                         // 3 or 5: calibrate affine, instead of the axes
+    uint16_t checksum(uint16_t* xCalibrationData,     // CRC of the calibration parameters and data
+                      uint16_t* yCalibrationData);
     void tapToCalibrate(uint16_t* xCalibrationData,   // Fill arrays with calibration data
                    uint16_t* yCalibrationData);       // If uncalibrated or recalibration is desired it calibrates first
 
@@ -97,7 +212,7 @@ class Calibrator : public Widget {
     uint16_t* getXAxisBuffer();                       // Buffer array for calibration marker values of the X-axis
     uint16_t* getYAxisBuffer();                       // Buffer array for calibration marker values of the Y-axis
 
-    bool     checkParameters();                       // Checks calibration parameters and persists them, if changed.
+    bool     checkParameters();                       // Uncalibrates if the persisted calibration does not fit
 
     void     printMarkerBuffer(char*     title,       // Prints the contents of a marker buffer
                                uint16_t* buffer, 
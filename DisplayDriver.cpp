@@ -0,0 +1,111 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <DisplayDriver.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+/*==============================================================================
+ *
+ *  A DisplayDriver hides the display hardware from the ScreenHandler.
+ *  All drawing is done using the Adafruit_GFX object returned by getGfx().
+ *  Only the controller initialization differs between the drivers.
+ *
+ *============================================================================*/
+
+/*-------------------------------------------------------------
+ *
+ *  Return the object type, so we know.
+ *
+ *-----------------------------------------------------------*/
+const char* DisplayDriver::isType() {
+  return "DisplayDriver";
+}
+
+#ifndef TERRABOX_HOST
+/*-----------------------------------------------------------------------------
+ *
+ *  Create a display driver for the MCUFRIEND TFT shields.
+ *
+ *  pTft    The MCUFRIEND driver for the TFT shield
+ *
+ *---------------------------------------------------------------------------*/
+McufriendDriver::McufriendDriver(MCUFRIEND_kbv* pTft) {
+  tft = pTft;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the GFX object used for drawing.
+ *
+ *---------------------------------------------------------------------------*/
+Adafruit_GFX* McufriendDriver::getGfx() {
+  return tft;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the ID of the display controller on the TFT shield.
+ *
+ *---------------------------------------------------------------------------*/
+uint16_t McufriendDriver::readID() {
+  return tft->readID();
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Initializes the display controller.
+ *
+ *  ID      The ID of the display controller
+ *
+ *---------------------------------------------------------------------------*/
+void McufriendDriver::begin(uint16_t ID) {
+  tft->begin(ID);
+}
+
+/*-------------------------------------------------------------
+ *
+ *  Return the object type, so we know.
+ *
+ *-----------------------------------------------------------*/
+const char* McufriendDriver::isType() {
+  return "McufriendDriver";
+}
+#endif
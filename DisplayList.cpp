@@ -0,0 +1,433 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <DisplayList.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+#define DEBUG_DISPLAY_LIST 0
+
+/*==============================================================================
+ *
+ *  A display list records the drawing of a frame, so it can be optimized
+ *  before it is sent over the bus to the display controller.
+ *
+ *  Between Screen.beginFrame() and Screen.endFrame() the Screen records its
+ *  fillRect(), fillRoundRect(), fillScreen() and print() calls here instead
+ *  of drawing them. State changes (setCursor(), setTextSize(), setTextColor())
+ *  are still applied right away, so getTextBounds() keeps working, and are
+ *  attached to the text they apply to. At the end of the frame:
+ *
+ *  o fills that are completely painted over later on are dropped,
+ *  o rectangles of equal color sharing an edge are merged into one,
+ *  o state changes which do not change the state are not sent.
+ *
+ *  The order of everything else is kept. When the list or the text arena
+ *  fills up, what is recorded so far is flushed and recording continues.
+ *
+ *  Note that drawing directly on Screen.tft during a frame is not recorded
+ *  and therefore happens before the recorded drawing.
+ *
+ *============================================================================*/
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Start recording a frame.
+ *
+ *  pGfx         The GFX object the frame is flushed to
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::begin(Adafruit_GFX* pGfx) {
+
+  gfx           = pGfx;
+  startX        = gfx->getCursorX();
+  startY        = gfx->getCursorY();
+  count         = 0;
+  textUsed      = 0;
+  open          = nullptr;
+  cursorSet     = false;
+  frameRecorded = 0;
+  frameEmitted  = 0;
+  recording     = true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Flush the recorded frame and stop recording.
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::end() {
+
+  flush();
+  recording = false;
+
+  #if DEBUG_DISPLAY_LIST
+  Serial.print(F("DisplayList frame recorded: ")); Serial.print(frameRecorded);
+  Serial.print(F(" emitted: ")); Serial.println(frameEmitted);
+  #endif
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Record a fill command. Flushes first if the list is full.
+ *
+ *  type         DL_FILL_RECT, DL_FILL_ROUND_RECT or DL_FILL_SCREEN
+ *  pX           X coordinate
+ *  pY           Y coordinate
+ *  pWidth       Width
+ *  pHeight      Height
+ *  pColor       Fill color
+ *  pRadius      Corner radius
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::add(uint8_t  type,
+		              int16_t  pX,     int16_t  pY,
+		              uint16_t pWidth, uint16_t pHeight,
+		              uint16_t pColor, int16_t  pRadius) {
+
+  if (count >= DISPLAY_LIST_SIZE)
+	flush();
+
+  DisplayCommand* c = &commands[count++];
+  c->type   = type;
+  c->x      = pX;
+  c->y      = pY;
+  c->width  = pWidth;
+  c->height = pHeight;
+  c->color  = pColor;
+  c->radius = pRadius;
+
+  recorded++;
+  frameRecorded++;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Record a state change. The state itself is kept in cursorX, cursorY,
+ *  textSize and textColor and attached to the next text.
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::state() {
+
+  recorded++;
+  frameRecorded++;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Start recording text. Everything printed to this list until endText()
+ *  becomes a single text command, drawn with the current text state.
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::beginText() {
+
+  if (count >= DISPLAY_LIST_SIZE || textUsed >= DISPLAY_LIST_TEXT)
+	flush();
+
+  open = &commands[count++];
+  open->type   = cursorSet ? DL_TEXT_AT : DL_TEXT;
+  open->x      = cursorX;
+  open->y      = cursorY;
+  open->size   = textSize;
+  open->color  = textColor;
+  open->bgColor = textBgColor;
+  open->width  = textUsed;
+  open->height = 0;
+
+  cursorSet = false;
+
+  recorded++;
+  frameRecorded++;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Finish recording text.
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::endText() {
+  open = nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Print interface. Appends a character to the text being recorded.
+ *  If the arena is full, the list is flushed and the text continues
+ *  in a new command.
+ *
+ *  c            The character to append
+ *
+ *---------------------------------------------------------------------------*/
+size_t DisplayList::write(uint8_t c) {
+
+  if (! open)
+	return 0;
+
+  if (textUsed >= DISPLAY_LIST_TEXT) {
+	open = nullptr;
+	flush();
+	beginText();
+  }
+
+  text[textUsed++] = c;
+  open->height++;
+
+  return 1;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if command c paints over every pixel command d paints.
+ *
+ *---------------------------------------------------------------------------*/
+bool DisplayList::covers(DisplayCommand* c, DisplayCommand* d) {
+
+  if (c->type == DL_FILL_SCREEN)
+	return true;
+
+  if (c->type != DL_FILL_RECT)
+	return false;
+
+  return c->x <= d->x && c->x + c->width  >= d->x + d->width &&
+		 c->y <= d->y && c->y + c->height >= d->y + d->height;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if commands c and d (may) paint the same pixels.
+ *  The extent of text is not known, so text overlaps everything.
+ *
+ *---------------------------------------------------------------------------*/
+bool DisplayList::overlaps(DisplayCommand* c, DisplayCommand* d) {
+
+  if (c->type == DL_TEXT || c->type == DL_TEXT_AT ||
+	  d->type == DL_TEXT || d->type == DL_TEXT_AT)
+	return true;
+
+  return c->x < d->x + d->width  && d->x < c->x + c->width &&
+		 c->y < d->y + d->height && d->y < c->y + c->height;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  If rectangles c and d have the same color and together form a rectangle,
+ *  d is grown to include c and true is returned.
+ *
+ *---------------------------------------------------------------------------*/
+bool DisplayList::merge(DisplayCommand* c, DisplayCommand* d) {
+
+  if (c->type != DL_FILL_RECT || d->type != DL_FILL_RECT || c->color != d->color)
+	return false;
+
+  //
+  //  Side by side
+  //
+  if (c->y == d->y && c->height == d->height &&
+	  (c->x + c->width == d->x || d->x + d->width == c->x)) {
+	d->x      = min(c->x, d->x);
+	d->width += c->width;
+	return true;
+  }
+
+  //
+  //  On top of each other
+  //
+  if (c->x == d->x && c->width == d->width &&
+	  (c->y + c->height == d->y || d->y + d->height == c->y)) {
+	d->y       = min(c->y, d->y);
+	d->height += c->height;
+	return true;
+  }
+
+  return false;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Drop the fills which are painted over later and merge rectangles.
+ *  Dropped commands get type DL_NONE.
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::optimize() {
+
+  //
+  //  Drop empty fills and fills painted over by a later one
+  //
+  for (uint8_t i = 0; i < count; i++) {
+	DisplayCommand* d = &commands[i];
+
+	if (d->type != DL_FILL_RECT && d->type != DL_FILL_ROUND_RECT && d->type != DL_FILL_SCREEN)
+	  continue;
+
+	if (d->width == 0 || d->height == 0) {
+	  d->type = DL_NONE;
+	  continue;
+	}
+
+	for (uint8_t j = i + 1; j < count; j++) {
+	  if (covers(&commands[j], d)) {
+		d->type = DL_NONE;
+		break;
+	  }
+	}
+  }
+
+  //
+  //  Merge an earlier rectangle into a later one, when nothing drawn
+  //  in between touches the earlier one. Repeat until nothing merges.
+  //
+  bool merged = true;
+  while (merged) {
+	merged = false;
+
+	for (uint8_t j = 1; j < count; j++) {
+	  for (uint8_t i = 0; i < j; i++) {
+		DisplayCommand* c = &commands[i];
+		if (c->type != DL_FILL_RECT)
+		  continue;
+
+		bool blocked = false;
+		for (uint8_t k = i + 1; k < j && ! blocked; k++)
+		  blocked = commands[k].type != DL_NONE && overlaps(&commands[k], c);
+
+		if (! blocked && merge(c, &commands[j])) {
+		  c->type = DL_NONE;
+		  merged  = true;
+		}
+	  }
+	}
+  }
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Send the optimized commands to the display, skipping state changes
+ *  which would not change the state.
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::replay() {
+
+  uint8_t  size      = 0;          // 0 means unknown
+  uint16_t color     = 0;
+  uint16_t bgColor   = 0;
+  bool     colorSet  = false;
+
+  for (uint8_t i = 0; i < count; i++) {
+	DisplayCommand* c = &commands[i];
+
+	switch (c->type) {
+
+	  case DL_FILL_RECT:
+		gfx->fillRect(c->x, c->y, c->width, c->height, c->color);
+		break;
+
+	  case DL_FILL_ROUND_RECT:
+		gfx->fillRoundRect(c->x, c->y, c->width, c->height, c->radius, c->color);
+		break;
+
+	  case DL_FILL_SCREEN:
+		gfx->fillScreen(c->color);
+		break;
+
+	  case DL_TEXT_AT:
+		gfx->setCursor(c->x, c->y);
+		emitted++;
+		frameEmitted++;
+		// Fall through
+
+	  case DL_TEXT:
+		if (c->size != size) {
+		  size = c->size;
+		  gfx->setTextSize(size);
+		  emitted++;
+		  frameEmitted++;
+		}
+		if (! colorSet || c->color != color || c->bgColor != bgColor) {
+		  color    = c->color;
+		  bgColor  = c->bgColor;
+		  colorSet = true;
+		  gfx->setTextColor(color, bgColor);
+		  emitted++;
+		  frameEmitted++;
+		}
+		for (uint16_t t = 0; t < c->height; t++)
+		  gfx->write(text[c->width + t]);
+		break;
+
+	  default:
+		continue;
+	}
+
+	emitted++;
+	frameEmitted++;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Optimize and replay what has been recorded so far and empty the list.
+ *  Afterwards the display state is the state at record time again.
+ *
+ *---------------------------------------------------------------------------*/
+void DisplayList::flush() {
+
+  if (! gfx || count == 0)
+	return;
+
+  //
+  //  Text continuing at the cursor starts where the cursor was when
+  //  recording started, not where later setCursor() calls left it.
+  //
+  gfx->setCursor(startX, startY);
+
+  optimize();
+  replay();
+
+  count    = 0;
+  textUsed = 0;
+  open     = nullptr;
+  startX   = gfx->getCursorX();
+  startY   = gfx->getCursorY();
+
+  gfx->setTextSize(textSize);
+  gfx->setTextColor(textColor, textBgColor);
+  if (cursorSet)
+	gfx->setCursor(cursorX, cursorY);
+}
@@ -631,7 +631,7 @@ void Dump::dumpAreaData(uint32_t addr) {
 void Dump::dumpPersistentAreas() {
 	  uint8_t rot = Screen.tft->getRotation();
 	  if (rot != 1 && rot != 3) {
-	    Screen.tft->setRotation(1);
+	    Screen.setRotation(1);
 	  }
 
 	  setCursor(0,0);
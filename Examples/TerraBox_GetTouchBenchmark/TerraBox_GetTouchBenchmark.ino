@@ -0,0 +1,187 @@
+#include <TerraBox_Widgets.h>
+
+//
+//  Replays a recorded trace of raw samples through Touch.getTouch()
+//  in every screen rotation. It reports the time per sample and
+//  checks the screen coordinates against a reference, which looks
+//  up the rotation for every sample and converts with a switch, as
+//  getTouch() did before the rotation transform was cached.
+//
+//  Runs on an Arduino and in a host build (TERRABOX_HOST).
+//
+
+#define CELL      20              // Marker distance in pixels
+#define X_MARKERS 17              // 320 pixels wide
+#define Y_MARKERS 25              // 480 pixels high
+#define SAMPLES   100             // Samples in the trace
+#define LOG_SIZE  1200            // Bytes for the recorded trace
+
+uint16_t xMarkers[X_MARKERS];
+uint16_t yMarkers[Y_MARKERS];
+
+//
+//  A Stream in memory, to record the trace to and replay it from.
+//
+class MemoryStream : public Stream {
+  public:
+    uint8_t  data[LOG_SIZE];
+    uint16_t length   = 0;
+    uint16_t position = 0;
+
+    size_t write(uint8_t c) {
+      if (length >= LOG_SIZE)
+        return 0;
+      data[length++] = c;
+      return 1;
+    }
+    int available() { return length - position; }
+    int read()      { return position < length ? data[position++] : -1; }
+    int peek()      { return position < length ? data[position]   : -1; }
+    void rewind()   { position = 0; }
+};
+
+MemoryStream trace;
+
+//
+//  Fill a marker array from lo to hi with some jitter,
+//  like a real calibration would.
+//
+void makeMarkers(uint16_t* markers, uint16_t size, uint16_t lo, uint16_t hi) {
+  randomSeed(size);
+  for (uint16_t i = 0; i < size; i++) {
+    markers[i] = lo + (uint32_t)(hi - lo) * i / (size - 1);
+    if (i > 0 && i < size - 1)
+      markers[i] += random(-5, 6);
+  }
+}
+
+//
+//  The raw touch source while recording: a few strokes over the
+//  panel with short releases in between.
+//
+uint16_t generated = 0;
+
+bool strokes(XY* data) {
+  uint16_t i = generated++;
+
+  data->x = 120 + (i * 37) % 780;
+  data->y = 100 + (i * 53) % 820;
+  data->z = 400;
+
+  bool pressed = i % 25 < 20;
+  if (!pressed)
+    data->z = 0;
+
+  return pressed;
+}
+
+//
+//  The conversion of getTouch() before the rotation was cached.
+//
+bool referenceTouch(XY* touchData) {
+  if (!getRawTouchData(touchData))
+    return false;
+
+  Touch.normalize(touchData);
+
+  switch (Screen.tft->getRotation()) {
+  case 0:
+    touchData->y = Screen.height - touchData->y;
+    break;
+  case 1:
+    touchData->y = Screen.height - touchData->y;
+    touchData->x = Screen.width  - touchData->x;
+    break;
+  case 2:
+    touchData->x = Screen.width - touchData->x;
+    break;
+  }
+
+  return true;
+}
+
+//
+//  Replay the trace once and return the time it took in us. The
+//  pressed samples are stored in, or compared to, xs and ys.
+//
+int16_t  xs[SAMPLES], ys[SAMPLES];
+uint16_t pressedCount = 0;
+uint16_t mismatches   = 0;
+
+unsigned long run(bool reference) {
+  trace.rewind();
+  Touch.filter.reset();
+  TouchLog.replay(&trace, false);
+
+  uint16_t n = 0;
+  unsigned long start = micros();
+  while (TouchLog.isReplaying()) {
+    XY xy;
+    bool pressed = reference ? referenceTouch(&xy) : Touch.getTouch(&xy);
+
+    if (pressed && n < SAMPLES) {
+      if (!reference) {
+        xs[n] = xy.x;
+        ys[n] = xy.y;
+      }
+      else if (xs[n] != xy.x || ys[n] != xy.y)
+        mismatches++;
+      n++;
+    }
+  }
+  unsigned long time = micros() - start;
+
+  pressedCount = n;
+  return time;
+}
+
+void setup() {
+  Serial.begin(115200);
+  Screen.begin();
+
+  makeMarkers(xMarkers, X_MARKERS, 110, 920);
+  makeMarkers(yMarkers, Y_MARKERS,  90, 940);
+
+  Touch.setMarkerDistance(CELL);
+  Touch.setXCalibration(X_MARKERS, xMarkers);
+  Touch.setYCalibration(Y_MARKERS, yMarkers);
+
+  //
+  //  The releases in the trace are not bridged
+  //
+  Touch.filter.bridgeTime = 0;
+
+  //
+  //  Record the trace
+  //
+  rawTouchSource = strokes;
+  TouchLog.record(&trace);
+  for (uint16_t i = 0; i < SAMPLES; i++) {
+    XY xy;
+    getRawTouchData(&xy);
+  }
+  TouchLog.stop();
+  rawTouchSource = nullptr;
+
+  for (uint8_t rotation = 0; rotation < 4; rotation++) {
+    Screen.setRotation(rotation);
+
+    unsigned long touchTime     = run(false);
+    unsigned long referenceTime = run(true);
+
+    Serial.print(F("Rotation "));    Serial.print(rotation);
+    Serial.print(F(" samples: "));   Serial.print(TouchLog.samples);
+    Serial.print(F(" pressed: "));   Serial.print(pressedCount);
+    Serial.print(F(" getTouch: "));  Serial.print(touchTime);
+    Serial.print(F(" us reference: ")); Serial.print(referenceTime);
+    Serial.println(F(" us"));
+  }
+
+  Screen.setRotation(0);
+
+  Serial.print(F("Mismatches: ")); Serial.println(mismatches);
+  Serial.println(mismatches ? F("FAILED") : F("PASSED"));
+}
+
+void loop() {
+}
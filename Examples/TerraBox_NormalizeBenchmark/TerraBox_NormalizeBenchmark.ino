@@ -0,0 +1,111 @@
+#include <TerraBox_Widgets.h>
+
+//
+//  Compares the float and the lookup table implementation of
+//  Touch.normalize() over every raw coordinate of a synthetic,
+//  slightly irregular calibration. It reports the time per
+//  normalization of both and checks they differ at most one pixel.
+//
+//  Runs on an Arduino and in a host build (TERRABOX_HOST).
+//
+
+#define CELL      20              // Marker distance in pixels
+#define X_MARKERS 17              // 320 pixels wide
+#define Y_MARKERS 25              // 480 pixels high
+#define RAW_MAX   1024            // Raw coordinates are 10 bits
+
+uint16_t xMarkers[X_MARKERS];
+uint16_t yMarkers[Y_MARKERS];
+
+//
+//  Fill a marker array from lo to hi with some jitter,
+//  like a real calibration would.
+//
+void makeMarkers(uint16_t* markers, uint16_t size, uint16_t lo, uint16_t hi) {
+  randomSeed(size);
+  for (uint16_t i = 0; i < size; i++) {
+    markers[i] = lo + (uint32_t)(hi - lo) * i / (size - 1);
+    if (i > 0 && i < size - 1)
+      markers[i] += random(-5, 6);
+  }
+}
+
+//
+//  Normalize every raw coordinate once and return the time it took in us.
+//  The results go to a volatile sink, so the compiler keeps the work.
+//
+volatile int16_t sink;
+
+unsigned long run(bool fast) {
+  Touch.fastNormalize = fast;
+
+  unsigned long start = micros();
+  for (uint16_t raw = 0; raw < RAW_MAX; raw++) {
+    XY xy;
+    xy.x = raw;
+    xy.y = raw;
+    Touch.normalize(&xy);
+    sink += xy.x + xy.y;
+  }
+
+  return micros() - start;
+}
+
+//
+//  Normalize a raw coordinate with the float or the table implementation.
+//
+XY normalized(bool fast, uint16_t raw) {
+  XY xy;
+  xy.x = raw;
+  xy.y = raw;
+  Touch.fastNormalize = fast;
+  Touch.normalize(&xy);
+  return xy;
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  makeMarkers(xMarkers, X_MARKERS, 110, 920);
+  makeMarkers(yMarkers, Y_MARKERS,  90, 940);
+
+  Touch.setMarkerDistance(CELL);
+  Touch.setXCalibration(X_MARKERS, xMarkers);
+  Touch.setYCalibration(Y_MARKERS, yMarkers);
+
+  unsigned long floatTime = run(false);
+  unsigned long tableTime = run(true);
+
+  uint16_t identical = 0;
+  uint16_t offByOne  = 0;
+  uint16_t failures  = 0;
+  for (uint16_t raw = 0; raw < RAW_MAX; raw++) {
+    XY ref = normalized(false, raw);
+    XY lut = normalized(true,  raw);
+    int16_t dx = abs(ref.x - lut.x);
+    int16_t dy = abs(ref.y - lut.y);
+    int16_t d  = max(dx, dy);
+
+    if (d == 0)
+      identical++;
+    else if (d == 1)
+      offByOne++;
+    else {
+      failures++;
+      Serial.print(F("MISMATCH raw: ")); Serial.print(raw);
+      Serial.print(F(" float: ")); Serial.print(ref.x); Serial.print(F(",")); Serial.print(ref.y);
+      Serial.print(F(" table: ")); Serial.print(lut.x); Serial.print(F(",")); Serial.println(lut.y);
+    }
+  }
+
+  Serial.print(F("Float normalize: ")); Serial.print(floatTime); Serial.println(F(" us"));
+  Serial.print(F("Table normalize: ")); Serial.print(tableTime); Serial.println(F(" us"));
+  Serial.print(F("Samples: "));         Serial.print(RAW_MAX);
+  Serial.print(F(" identical: "));      Serial.print(identical);
+  Serial.print(F(" off by one: "));     Serial.print(offByOne);
+  Serial.print(F(" off by more: "));    Serial.println(failures);
+  Serial.println(failures ? F("FAILED") : F("PASSED"));
+}
+
+void loop() {
+}
@@ -0,0 +1,254 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <FrameBufferDriver.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+#include <FrameBufferDriver.h>
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Create a frame buffer driver. The buffer is allocated on the heap and
+ *  cleared to BLACK.
+ *
+ *  pWidth      The width in pixels in rotation 0
+ *  pHeight     The height in pixels in rotation 0
+ *
+ *---------------------------------------------------------------------------*/
+FrameBufferDriver::FrameBufferDriver(uint16_t pWidth, uint16_t pHeight)
+                 : Adafruit_GFX(pWidth, pHeight) {
+
+  buffer = (uint16_t*)calloc((uint32_t)pWidth * pHeight, sizeof(uint16_t));
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the GFX object used for drawing, which is the driver itself.
+ *
+ *---------------------------------------------------------------------------*/
+Adafruit_GFX* FrameBufferDriver::getGfx() {
+  return this;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the ID of the display controller it pretends to be.
+ *
+ *---------------------------------------------------------------------------*/
+uint16_t FrameBufferDriver::readID() {
+  return FRAMEBUFFER_ID;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Initializes the frame buffer, like a TFT it is cleared to BLACK.
+ *
+ *  ID      The ID of the display controller, ignored.
+ *
+ *---------------------------------------------------------------------------*/
+void FrameBufferDriver::begin(uint16_t /* ID */) {
+
+  setRotation(0);
+
+  if (buffer)
+    memset(buffer, 0, (uint32_t)WIDTH * HEIGHT * sizeof(uint16_t));
+
+  resetStatistics();
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Fill a rectangle, specified in the current rotation, in the frame buffer.
+ *  The rectangle is clipped to the screen. It is not counted as a draw call.
+ *
+ *  x, y        Upper left corner
+ *  w, h        Width and height, negative values grow to the left or up
+ *  color       The RGB565 color
+ *
+ *---------------------------------------------------------------------------*/
+void FrameBufferDriver::fill(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+
+  if (!buffer)
+	return;
+
+  //
+  //  Normalize negative sizes, just like Adafruit_GFX does
+  //
+  if (w < 0) {
+	x += w + 1;
+	w  = -w;
+  }
+
+  if (h < 0) {
+	y += h + 1;
+	h  = -h;
+  }
+
+  //
+  //  Clip to the screen in the current rotation
+  //
+  int16_t x2 = x + w;
+  int16_t y2 = y + h;
+
+  if (x < 0)       x  = 0;
+  if (y < 0)       y  = 0;
+  if (x2 > _width) x2 = _width;
+  if (y2 > _height)y2 = _height;
+
+  if (x >= x2 || y >= y2)
+	return;
+
+  //
+  //  Write the pixels, mapping them onto the rotation 0 buffer
+  //
+  for (int16_t py = y; py < y2; py++) {
+	for (int16_t px = x; px < x2; px++) {
+
+	  int16_t bx = px;
+	  int16_t by = py;
+
+	  switch (rotation) {
+	  case 1:
+		bx = WIDTH - 1 - py;
+		by = px;
+		break;
+	  case 2:
+		bx = WIDTH  - 1 - px;
+		by = HEIGHT - 1 - py;
+		break;
+	  case 3:
+		bx = py;
+		by = HEIGHT - 1 - px;
+		break;
+	  }
+
+	  buffer[(uint32_t)by * WIDTH + bx] = color;
+	}
+  }
+
+  pixelsWritten += (uint32_t)(x2 - x) * (uint32_t)(y2 - y);
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  GFX primitives, each of them counts as a single draw call.
+ *
+ *---------------------------------------------------------------------------*/
+void FrameBufferDriver::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  drawCalls++;
+  fill(x, y, 1, 1, color);
+}
+
+void FrameBufferDriver::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) {
+  drawCalls++;
+  fill(x, y, 1, h, color);
+}
+
+void FrameBufferDriver::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) {
+  drawCalls++;
+  fill(x, y, w, 1, color);
+}
+
+void FrameBufferDriver::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  drawCalls++;
+  fill(x, y, w, h, color);
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the color of a pixel, in the current rotation.
+ *  Pixels outside of the screen are returned BLACK.
+ *
+ *  x, y        The pixel coordinates
+ *
+ *---------------------------------------------------------------------------*/
+uint16_t FrameBufferDriver::getPixel(int16_t x, int16_t y) {
+
+  if (!buffer || x < 0 || y < 0 || x >= _width || y >= _height)
+	return BLACK;
+
+  int16_t bx = x;
+  int16_t by = y;
+
+  switch (rotation) {
+  case 1:
+	bx = WIDTH - 1 - y;
+	by = x;
+	break;
+  case 2:
+	bx = WIDTH  - 1 - x;
+	by = HEIGHT - 1 - y;
+	break;
+  case 3:
+	bx = y;
+	by = HEIGHT - 1 - x;
+	break;
+  }
+
+  return buffer[(uint32_t)by * WIDTH + bx];
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the frame buffer, which is always organised as rotation 0.
+ *
+ *---------------------------------------------------------------------------*/
+uint16_t* FrameBufferDriver::getBuffer() {
+  return buffer;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Zero the statistics, typically at the start of a frame.
+ *
+ *---------------------------------------------------------------------------*/
+void FrameBufferDriver::resetStatistics() {
+  pixelsWritten = 0;
+  drawCalls     = 0;
+}
+
+/*-------------------------------------------------------------
+ *
+ *  Return the object type, so we know.
+ *
+ *-----------------------------------------------------------*/
+const char* FrameBufferDriver::isType() {
+  return "FrameBufferDriver";
+}
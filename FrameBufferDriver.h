@@ -0,0 +1,100 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <FrameBufferDriver.h> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+#ifndef FRAMEBUFFERDRIVER_h
+#define FRAMEBUFFERDRIVER_h
+
+#define FRAMEBUFFER_WIDTH   320       // Width of the MCUFRIEND shields in rotation 0
+#define FRAMEBUFFER_HEIGHT  480       // Height of the MCUFRIEND shields in rotation 0
+#define FRAMEBUFFER_ID      0x9486    // The controller ID it pretends to be
+
+/*============================================================================
+ *  F R A M E  B U F F E R  D R I V E R
+ *
+ *  Draws into a RGB565 frame buffer in RAM instead of on a TFT shield.
+ *  It is meant for building and running the library on a PC, where it
+ *  counts the pixels written and the draw calls performed.
+ *  A draw call is a single address window setup on a real TFT,
+ *  i.e. a fillRect(), drawFastHLine(), drawFastVLine() or drawPixel().
+ *===========================================================================*/
+class FrameBufferDriver : public DisplayDriver, public Adafruit_GFX {
+  private:
+    uint16_t* buffer;                 // The frame buffer, WIDTH x HEIGHT pixels
+
+    void      fill(int16_t x,  int16_t y,       // Fill a clipped rectangle
+                   int16_t w,  int16_t h,
+                   uint16_t color);
+
+  public:
+    uint32_t  pixelsWritten = 0;      // Number of pixels written
+    uint32_t  drawCalls     = 0;      // Number of draw calls performed
+
+    FrameBufferDriver(uint16_t pWidth, uint16_t pHeight);
+
+    //
+    //  Display driver
+    //
+    virtual Adafruit_GFX* getGfx();
+    virtual uint16_t      readID();
+    virtual void          begin(uint16_t ID);
+
+    //
+    //  GFX primitives
+    //
+    virtual void  drawPixel(int16_t x, int16_t y, uint16_t color);
+    virtual void  drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color);
+    virtual void  drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color);
+    virtual void  fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+
+    //
+    //  Frame buffer access and statistics
+    //
+    uint16_t      getPixel(int16_t x, int16_t y);  // Color at (x, y) in the current rotation
+    uint16_t*     getBuffer();                     // The raw frame buffer in rotation 0
+    void          resetStatistics();               // Zero the pixel and draw call counters
+
+    virtual const char* isType();
+};
+
+#endif
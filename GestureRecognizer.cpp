@@ -0,0 +1,199 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <GestureRecognizer.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+#define GESTURE_IDLE      0           // Not touched
+#define GESTURE_PRESSED   1           // Touched, but not moved beyond dragDistance
+#define GESTURE_DRAGGING  2           // Touched and moving
+
+/*==============================================================================
+ *
+ *  Recognizes gestures in the stream of touch samples digested by the
+ *  TouchHandler. Every sample is handled in constant time and no memory
+ *  is allocated, only the state of the touch in progress is kept:
+ *
+ *  LONG_PRESS   Sent once, when a touch did not move for longPressTime ms.
+ *  DRAG         Sent for every sample of a touch that moved more than
+ *               dragDistance pixels, with its velocity.
+ *  SWIPE_*      Sent when a touch is lifted after covering swipeDistance
+ *               pixels, while moving at swipeVelocity or faster. The
+ *               direction is that of the longest axis.
+ *  DOUBLE_TAP   Sent when a touch of at most maxTapTime ms follows a
+ *               similar tap within doubleTapInterval ms and
+ *               doubleTapDistance pixels.
+ *
+ *  The velocity is smoothed over the samples, every new sample counts for
+ *  half of it.
+ *
+ *============================================================================*/
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Feed the next sample. Returns the gesture event code it completes, or
+ *  TouchEvents::NONE. The position and velocity of the gesture are in x, y,
+ *  vx and vy.
+ *
+ *  pressed      Whether the screen is touched
+ *  pX, pY       Screen coordinates of the touch, if pressed
+ *  now          Time of the sample in milliseconds
+ *
+ *---------------------------------------------------------------------------*/
+uint16_t GestureRecognizer::sample(bool pressed, int16_t pX, int16_t pY, unsigned long now) {
+
+  //
+  //  Start of a touch
+  //
+  if (state == GESTURE_IDLE) {
+	if (!pressed)
+	  return TouchEvents::NONE;
+
+	state       = GESTURE_PRESSED;
+	longPressed = false;
+	matched     = false;
+	target      = nullptr;
+	downTime    = now;
+	lastTime    = now;
+	startX      = lastX = x = pX;
+	startY      = lastY = y = pY;
+	vx          = 0;
+	vy          = 0;
+
+	return TouchEvents::NONE;
+  }
+
+  //
+  //  Touch in progress
+  //
+  if (pressed) {
+	unsigned long dt = now - lastTime;
+	if (dt) {
+	  //
+	  //  A fast move between close samples exceeds 16 bits, e.g. 40 pixels
+	  //  in 1 ms, keep it at the maximum instead of wrapping around
+	  //
+	  int32_t sx = (vx + (int32_t)(pX - lastX) * 1000 / (long)dt) / 2;
+	  int32_t sy = (vy + (int32_t)(pY - lastY) * 1000 / (long)dt) / 2;
+	  vx = constrain(sx, (int32_t)INT16_MIN, (int32_t)INT16_MAX);
+	  vy = constrain(sy, (int32_t)INT16_MIN, (int32_t)INT16_MAX);
+	  lastTime = now;
+	}
+
+	bool moved = pX != lastX || pY != lastY;
+	lastX = x = pX;
+	lastY = y = pY;
+
+	if (state == GESTURE_PRESSED) {
+	  if (abs(pX - startX) > dragDistance || abs(pY - startY) > dragDistance) {
+		state = GESTURE_DRAGGING;
+		return TouchEvents::DRAG;
+	  }
+
+	  if (!longPressed && now - downTime >= longPressTime) {
+		longPressed = true;
+		return TouchEvents::LONG_PRESS;
+	  }
+
+	  return TouchEvents::NONE;
+	}
+
+	return moved ? TouchEvents::DRAG : TouchEvents::NONE;
+  }
+
+  //
+  //  End of the touch, the last pressed sample tells where
+  //
+  uint8_t wasState = state;
+  state            = GESTURE_IDLE;
+  x                = lastX;
+  y                = lastY;
+
+  int16_t dx = lastX - startX;
+  int16_t dy = lastY - startY;
+
+  if (wasState == GESTURE_DRAGGING) {
+	tapTime = 0;
+
+	if (abs(dx) >= abs(dy)) {
+	  if (abs(dx) >= swipeDistance && abs(vx) >= swipeVelocity)
+		return dx < 0 ? TouchEvents::SWIPE_LEFT : TouchEvents::SWIPE_RIGHT;
+	}
+	else {
+	  if (abs(dy) >= swipeDistance && abs(vy) >= swipeVelocity)
+		return dy < 0 ? TouchEvents::SWIPE_UP : TouchEvents::SWIPE_DOWN;
+	}
+
+	return TouchEvents::NONE;
+  }
+
+  //
+  //  A touch that did not move, is it a tap?
+  //
+  if (longPressed || now - downTime > maxTapTime) {
+	tapTime = 0;
+	return TouchEvents::NONE;
+  }
+
+  if (tapTime && downTime - tapTime <= doubleTapInterval &&
+	  abs(lastX - tapX) <= doubleTapDistance && abs(lastY - tapY) <= doubleTapDistance) {
+	tapTime = 0;
+	return TouchEvents::DOUBLE_TAP;
+  }
+
+  tapTime = now;
+  tapX    = lastX;
+  tapY    = lastY;
+
+  return TouchEvents::NONE;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Forget the touch in progress and the last tap.
+ *
+ *---------------------------------------------------------------------------*/
+void GestureRecognizer::reset() {
+  state   = GESTURE_IDLE;
+  tapTime = 0;
+  matched = false;
+  target  = nullptr;
+}
@@ -230,6 +230,12 @@ void LabelWidget::setText(char* newText) {
 	 return;
    }
 
+   //
+   //  Only redraw what changed, if possible
+   //
+   if (diffText && updateText(newText))
+	 return;
+
    clearText();
 
   //
@@ -258,6 +264,102 @@ void LabelWidget::setText(char* newText) {
   }
 }
 
+/*-------------------------------------------------------------------------------
+ *
+ *  Replaces the displayed text by only redrawing the characters that changed.
+ *
+ *  With the built-in font each character occupies a fixed cell. Printed with
+ *  an opaque background, a character paints its entire cell, so the old text
+ *  does not have to be cleared first. If both texts have the same length, only
+ *  the runs of changed characters are printed. Otherwise the new text is
+ *  printed in full and only the parts of the old text sticking out are cleared.
+ *
+ *  Returns false if this is not possible (GFX font, multiple lines, wrapping,
+ *  empty text), in which case the caller redraws the text as usual.
+ *
+ *  newText      The new text
+ *
+ *-----------------------------------------------------------------------------*/
+bool LabelWidget::updateText(char* newText) {
+
+  if (! Screen.textMetrics.classicFont)
+	return false;
+
+  if (newText == nullptr || newText[0] == '\0' || text[0] == '\0')
+	return false;
+
+  uint16_t oldLength = strlen(text);
+  uint16_t newLength = strlen(newText);
+  if (newLength >= sizeof(text) || strchr(text, '\n') || strchr(newText, '\n'))
+	return false;
+
+  //
+  //  Both texts must be on a single line of whole character cells
+  //
+  Screen.setTextSize(size);
+
+  int16_t  xr, yr;
+  uint16_t oldWidth, oldHeight, newWidth, newHeight;
+  Screen.getTextBounds(text,    x, y, &xr, &yr, &oldWidth, &oldHeight);
+  Screen.getTextBounds(newText, x, y, &xr, &yr, &newWidth, &newHeight);
+
+  uint16_t cell = CLASSIC_FONT_WIDTH * size;
+  if (oldWidth != oldLength * cell || newWidth != newLength * cell)
+	return false;
+
+  uint16_t fg    = inverted ? ~fgColor : fgColor;
+  uint16_t bg    = inverted ? ~bgColor : bgColor;
+  int16_t  textX = centerX - newWidth/2;
+  int16_t  textY = centerY - round(float(newHeight/2.0));
+
+  Screen.setTextColor(fg, bg);
+
+  if (oldLength == newLength) {
+
+	//
+	//  Print each run of changed characters
+	//
+	char run[sizeof(text)];
+	for (uint16_t i = 0; i < newLength; ) {
+	  if (text[i] == newText[i]) {
+		i++;
+		continue;
+	  }
+
+	  uint16_t j = i;
+	  while (j < newLength && text[j] != newText[j])
+		j++;
+
+	  memcpy(run, &newText[i], j - i);
+	  run[j - i] = '\0';
+
+	  Screen.setCursor(textX + i * cell, textY);
+	  Screen.print(run);
+
+	  i = j;
+	}
+  }
+  else {
+
+	//
+	//  Print the new text and clear what is left of the old one
+	//
+	Screen.setCursor(textX, textY);
+	Screen.print(newText);
+
+	int16_t oldX = centerX - oldWidth/2;
+	if (oldX < textX)
+	  Screen.fillRect(oldX, textY, textX - oldX, oldHeight, bg);
+	if (oldX + oldWidth > textX + newWidth)
+	  Screen.fillRect(textX + newWidth, textY, (oldX + oldWidth) - (textX + newWidth), oldHeight, bg);
+  }
+
+  Screen.setTextColor(fg);        // Back to a transparent background
+
+  strncpy(text, newText, sizeof(text)-1);
+  return true;
+}
+
 /*-------------------------------------------------------------------------------
  *
  *  Clears the text currently displayed.
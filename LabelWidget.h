@@ -62,10 +62,13 @@ class  LabelWidget : public RectangleWidget {
     int16_t  yMax;	// The y coordinate of the labels lower right corner.
     uint16_t type = LABEL_SQUARE;  // Default type is SQUARE
 
+    bool     updateText(char* newText);  // Redraw only the characters that changed
+
   public:
     uint16_t  size;
     uint16_t  fgColor;
     char      text[64];
+    bool      diffText = false;  // If true setText() only redraws the characters that changed
 
              LabelWidget(
                  Widget* parent,
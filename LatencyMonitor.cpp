@@ -0,0 +1,383 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <LatencyMonitor.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+/*==============================================================================
+ *
+ *  Measures the time from taking a raw touch sample up to the moment the
+ *  display shows the result of it, i.e. the touch to photon latency.
+ *
+ *  getRawTouchData() stamps every sample with micros(). The TouchHandler
+ *  passes the stamp on to the events it generates. When such an event is
+ *  dispatched, the monitor watches for draw primitives completing. The
+ *  latency is the time of the last primitive drawn for the event minus the
+ *  stamp of its sample. An event that only invalidates a part of the screen,
+ *  or is dispatched while a frame is being recorded, is measured when the
+ *  repaint at the end of the frame is finished. Events that draw nothing are
+ *  not measured.
+ *
+ *  The latencies are counted in log2 histograms, per event code and per
+ *  source widget. The histograms are only allocated by begin(), so the
+ *  monitor costs no memory until it is used.
+ *
+ *============================================================================*/
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Count a latency in the histogram.
+ *
+ *  latency      The latency in microseconds
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyHistogram::add(uint32_t latency) {
+
+  if (!count || latency < min)
+	min = latency;
+  if (latency > max)
+	max = latency;
+
+  count++;
+  total += latency;
+
+  uint8_t b = 0;
+  while (latency > 1 && b < LATENCY_BUCKETS - 1) {
+	latency >>= 1;
+	b++;
+  }
+
+  if (buckets[b] < 0xFFFF)
+	buckets[b]++;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the average latency in microseconds.
+ *
+ *---------------------------------------------------------------------------*/
+uint32_t LatencyHistogram::average() {
+  return count ? (uint32_t)(total / count) : 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the latency pct percent of the measured latencies do not exceed.
+ *  It is the upper bound of the bucket it falls in, but never more than
+ *  the longest latency measured.
+ *
+ *  pct          The percentage, e.g. 99
+ *
+ *---------------------------------------------------------------------------*/
+uint32_t LatencyHistogram::percentile(uint8_t pct) {
+
+  uint32_t counted = 0;
+  for (uint8_t b = 0; b < LATENCY_BUCKETS; b++)
+	counted += buckets[b];
+
+  if (!counted)
+	return 0;
+
+  uint32_t wanted = ((uint64_t)counted * pct + 99) / 100;
+  uint32_t seen   = 0;
+
+  for (uint8_t b = 0; b < LATENCY_BUCKETS - 1; b++) {
+	seen += buckets[b];
+	if (seen >= wanted) {
+	  uint32_t bound = ((uint32_t)2 << b) - 1;
+	  return bound < max ? bound : max;
+	}
+  }
+
+  return max;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Print the number of latencies, the min, average, p99 and max latency in
+ *  microseconds on a single line.
+ *
+ *  out          Where to print it, e.g. &Serial
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyHistogram::print(Print* out) {
+  out->print(F(" n "));    out->print(count);
+  out->print(F(" min "));  out->print(min);
+  out->print(F(" avg "));  out->print(average());
+  out->print(F(" p99 "));  out->print(percentile(99));
+  out->print(F(" max "));  out->println(max);
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Start measuring. Returns false if the histograms could not be allocated.
+ *
+ *---------------------------------------------------------------------------*/
+bool LatencyMonitor::begin() {
+
+  if (events)
+	return true;
+
+  events    = (LatencyHistogram*) malloc(LATENCY_EVENT_TYPES * sizeof(LatencyHistogram));
+  widgets   = (LatencyHistogram*) malloc(LATENCY_WIDGETS * sizeof(LatencyHistogram));
+  widgetIds = (Widget**) malloc(LATENCY_WIDGETS * sizeof(Widget*));
+
+  if (!events || !widgets || !widgetIds) {
+	end();
+	return false;
+  }
+
+  clear();
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Stop measuring and free the histograms.
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::end() {
+
+  free(events);
+  free(widgets);
+  free(widgetIds);
+
+  events    = nullptr;
+  widgets   = nullptr;
+  widgetIds = nullptr;
+  depth     = 0;
+  pending   = false;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if latencies are being measured.
+ *
+ *---------------------------------------------------------------------------*/
+bool LatencyMonitor::isEnabled() {
+  return events != nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Forget all measured latencies.
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::clear() {
+
+  if (!events)
+	return;
+
+  memset(events,  0, LATENCY_EVENT_TYPES * sizeof(LatencyHistogram));
+  memset(widgets, 0, LATENCY_WIDGETS * sizeof(LatencyHistogram));
+  widgetCount = 0;
+  pending     = false;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  An event is about to be dispatched. Only the outermost dispatch of an
+ *  event stemming from a touch sample is measured.
+ *
+ *  e            The event
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::dispatchStarted(TouchEvent* e) {
+
+  if (!events)
+	return;
+
+  if (depth++)
+	return;
+
+  stamp        = e->rawStamp;
+  event        = e->event;
+  widget       = (Widget*)e->source;
+  drawsAtStart = draws;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  The dispatch of the event has finished. If it was drawn, its latency is
+ *  known. If it is still to be drawn by the repaint, it waits for that.
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::dispatchFinished() {
+
+  if (!events || !depth || --depth || !stamp)
+	return;
+
+  if (draws != drawsAtStart) {
+	record(event, widget, lastDraw - stamp);
+	return;
+  }
+
+  if (!pending && (Screen.hasDamage() || Screen.displayList.recording)) {
+	pending        = true;
+	pendingStamp   = stamp;
+	pendingEvent   = event;
+	pendingWidget  = widget;
+	drawsAtPending = draws;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  A draw primitive has completed.
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::drawn() {
+
+  if (!events)
+	return;
+
+  lastDraw = micros();
+  draws++;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  The repaint at the end of the frame has finished. The event waiting for
+ *  it is measured, if anything was drawn.
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::frameFinished() {
+
+  if (!pending)
+	return;
+
+  if (draws != drawsAtPending)
+	record(pendingEvent, pendingWidget, lastDraw - pendingStamp);
+
+  pending = false;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Count a latency for the event code and for the widget.
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::record(uint16_t pEvent, Widget* pWidget, uint32_t latency) {
+
+  LatencyHistogram* h = eventHistogram(pEvent);
+  if (h)
+	h->add(latency);
+
+  if (!pWidget)
+	return;
+
+  h = widgetHistogram(pWidget);
+  if (!h && widgetCount < LATENCY_WIDGETS) {
+	widgetIds[widgetCount] = pWidget;
+	h = &widgets[widgetCount++];
+  }
+
+  if (h)
+	h->add(latency);
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the histogram of an event code, or nullptr if there is none.
+ *
+ *  pEvent       The event code, see TouchEvents
+ *
+ *---------------------------------------------------------------------------*/
+LatencyHistogram* LatencyMonitor::eventHistogram(uint16_t pEvent) {
+
+  if (!events || pEvent >= LATENCY_EVENT_TYPES)
+	return nullptr;
+
+  return &events[pEvent];
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the histogram of a widget, or nullptr if there is none. Only the
+ *  first LATENCY_WIDGETS widgets that were drawn for an event get one.
+ *
+ *  pWidget      The widget
+ *
+ *---------------------------------------------------------------------------*/
+LatencyHistogram* LatencyMonitor::widgetHistogram(Widget* pWidget) {
+
+  for (uint8_t i = 0; i < widgetCount; i++) {
+	if (widgetIds[i] == pWidget)
+	  return &widgets[i];
+  }
+
+  return nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Report the histograms that have measured latencies, in microseconds.
+ *
+ *  out          Where to print it, e.g. &Serial
+ *
+ *---------------------------------------------------------------------------*/
+void LatencyMonitor::print(Print* out) {
+
+  if (!events) {
+	out->println(F("Latency monitor not enabled"));
+	return;
+  }
+
+  out->println(F("Touch to display latency in us"));
+
+  for (uint8_t i = 0; i < LATENCY_EVENT_TYPES; i++) {
+	if (!events[i].count)
+	  continue;
+
+	out->print(F("event "));
+	out->print(i);
+	events[i].print(out);
+  }
+
+  for (uint8_t i = 0; i < widgetCount; i++) {
+	out->print(F("widget "));
+	out->print(widgetIds[i]->nameId);
+	out->print(F(" 0x"));
+	out->print((uint32_t)(uintptr_t)widgetIds[i], HEX);
+	widgets[i].print(out);
+  }
+}
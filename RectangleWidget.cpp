@@ -107,56 +107,187 @@ uint16_t RectangleWidget::getStroke() {
 
 /*---------------------------------------------------------------------------------
  *
- *  Draw the rectangle on the screen.
+ *  Calculates how many pixels the rounded corners cut off the rows near the
+ *  top (and bottom) edge. Uses the same midpoint circle steps as
+ *  Adafruit_GFX::fillRoundRect(), so the shape is identical.
+ *
+ *  r        The corner radius, at most RECTANGLE_RADIUS
+ *  cuts     Receives for the rows 0..r-1 the number of pixels cut off each end
  *
  *-------------------------------------------------------------------------------*/
-void RectangleWidget::draw() {
-  inverted = false;
-
-  if (! isVisible())
-	  return;
+static void roundCuts(int16_t r, uint8_t* cuts) {
 
   //
-  //  Draw stroke around rectangle
+  //  For each column left of the corner center the first row drawn
   //
-  if (stroke != 0) {
-#if DEBUG
-    Serial.print(F("RectangleWidget::draw strokeColor: 0x"));
-    Serial.println(strokeColor, HEX);
-#endif
+  uint8_t top[RECTANGLE_RADIUS + 1];
+  for (int16_t c = 0; c < r; c++)
+    top[c] = 255;
+
+  int16_t f     = 1 - r;
+  int16_t ddF_x = 1;
+  int16_t ddF_y = -2 * r;
+  int16_t cx    = 0;
+  int16_t cy    = r;
+  int16_t px    = cx;
+  int16_t py    = cy;
+
+  while (cx < cy) {
+    if (f >= 0) {
+      cy--;
+      ddF_y += 2;
+      f     += ddF_y;
+    }
+    cx++;
+    ddF_x += 2;
+    f     += ddF_x;
 
+    if (cx < cy + 1)
+      top[r - cx] = min(top[r - cx], r - cy);
 
-    switch (type) {
-    case RECTANGLE_ROUNDED:
-  	  Screen.fillRoundRect(x, y, width, height, RECTANGLE_RADIUS, strokeColor);
-  	  break;
+    if (cy != py) {
+      top[r - py] = min(top[r - py], r - px);
+      py = cy;
+    }
+    px = cx;
+  }
 
-    case RECTANGLE_SQUARE:
-    default:
-  	  Screen.fillRect(x, y, width, height, strokeColor);
+  //
+  //  A row starts at the first column drawn at or above it
+  //
+  for (int16_t row = 0; row < r; row++) {
+    cuts[row] = r;
+    for (int16_t c = 0; c < r; c++) {
+      if (top[c] <= row) {
+        cuts[row] = c;
+        break;
+      }
     }
   }
+}
+
+/*---------------------------------------------------------------------------------
+ *
+ *  Returns the number of pixels the corners cut off both ends of a row.
+ *
+ *  row      The row, relative to the top of the shape
+ *  h        The height of the shape
+ *  r        The corner radius
+ *  cuts     The cuts calculated by roundCuts()
+ *
+ *-------------------------------------------------------------------------------*/
+static int16_t rowCut(int16_t row, int16_t h, int16_t r, uint8_t* cuts) {
+
+  if (row < r)
+    return cuts[row];
+
+  if (row >= h - r)
+    return cuts[h - 1 - row];
+
+  return 0;
+}
+
+/*---------------------------------------------------------------------------------
+ *
+ *  Paint the rectangle, writing every pixel only once.
+ *
+ *  The stroke is painted as bands left and right of the inner area, plus
+ *  full width bands above and below it. Rows with the same spans are
+ *  combined into a single fill, so a square rectangle takes at most five
+ *  fills. Rounded corners only add fills for the rows they cut into.
+ *
+ *  fillColor    The color of the inner area
+ *  edgeColor    The color of the stroke
+ *
+ *-------------------------------------------------------------------------------*/
+void RectangleWidget::paint(uint16_t fillColor, uint16_t edgeColor) {
+
+  int16_t w  = width;
+  int16_t h  = height;
+  int16_t s  = stroke;
+  int16_t iw = w - 2 * s;                  // Inner width
+  int16_t ih = h - 2 * s;                  // Inner height
+
+  if (w <= 0 || h <= 0)
+    return;
+
+  bool hasInner = iw > 0 && ih > 0;
+  if (! hasInner)
+    s = 0;
 
   //
-  //  Fill up the inner rectangle
+  //  Corner radii, limited like Adafruit_GFX::fillRoundRect() does
   //
+  int16_t ro = 0;
+  int16_t ri = 0;
+  uint8_t outerCuts[RECTANGLE_RADIUS + 1];
+  uint8_t innerCuts[RECTANGLE_RADIUS + 1];
+
+  if (type == RECTANGLE_ROUNDED) {
+    ro = min((int16_t)RECTANGLE_RADIUS, (int16_t)(min(w, h) / 2));
+    roundCuts(ro, outerCuts);
+
+    if (hasInner) {
+      ri = min((int16_t)RECTANGLE_RADIUS, (int16_t)(min(iw, ih) / 2));
+      roundCuts(ri, innerCuts);
+    }
+  }
 
-  #if DEBUG
-  Serial.print(F("RectangleWidget::draw bgColor: 0x"));
-  Serial.println(bgColor, HEX);
-  #endif
+  //
+  //  Paint runs of rows with equal spans
+  //
+  int16_t row = 0;
+  while (row < h) {
+
+    bool    inner = hasInner && row >= s && row < s + ih;
+    int16_t oc    = rowCut(row, h, ro, outerCuts);
+    int16_t ic    = inner ? rowCut(row - s, ih, ri, innerCuts) : 0;
+
+    int16_t run = 1;
+    while (row + run < h) {
+      int16_t next      = row + run;
+      bool    nextInner = hasInner && next >= s && next < s + ih;
+      if (nextInner != inner ||
+          rowCut(next, h, ro, outerCuts) != oc ||
+          (inner && rowCut(next - s, ih, ri, innerCuts) != ic))
+        break;
+      run++;
+    }
 
-  switch(type) {
-  case RECTANGLE_ROUNDED:
-    Screen.fillRoundRect(x + stroke, y + stroke, width-2*stroke, height-2*stroke, RECTANGLE_RADIUS, bgColor);
-    break;
+    if (! inner) {
+      fill(x + oc, y + row, w - 2 * oc, run, edgeColor);
+    }
+    else {
+      fill(x + oc,          y + row, s + ic - oc,  run, edgeColor);
+      fill(x + s + ic,      y + row, iw - 2 * ic,  run, fillColor);
+      fill(x + w - s - ic,  y + row, s + ic - oc,  run, edgeColor);
+    }
 
-  case RECTANGLE_SQUARE:
-  default:
-   Screen.fillRect(x + stroke, y + stroke, width-2*stroke, height-2*stroke, bgColor);
+    row += run;
   }
 }
 
+/*---------------------------------------------------------------------------------
+ *
+ *  Draw the rectangle on the screen.
+ *
+ *-------------------------------------------------------------------------------*/
+void RectangleWidget::draw() {
+  inverted = false;
+
+  if (! isVisible())
+	  return;
+
+#if DEBUG
+  Serial.print(F("RectangleWidget::draw strokeColor: 0x"));
+  Serial.print(strokeColor, HEX);
+  Serial.print(F(" bgColor: 0x"));
+  Serial.println(bgColor, HEX);
+#endif
+
+  paint(bgColor, strokeColor);
+}
+
 /*---------------------------------------------------------------------------------
  *
  *  Draw the rectangle on the screen with inverted colours
@@ -172,44 +303,14 @@ void RectangleWidget::drawInverted() {
   uint16_t invStrokeColor = ~strokeColor;
   uint16_t invBgColor     = ~bgColor;
 
-  //
-  //  Draw stroke around rectangle
-  //
-  if (stroke != 0) {
 #if DEBUG
-    Serial.print(F("RectangleWidget::draw invStrokeColor: 0x"));
-    Serial.println(invStrokeColor, HEX);
+  Serial.print(F("RectangleWidget::draw invStrokeColor: 0x"));
+  Serial.print(invStrokeColor, HEX);
+  Serial.print(F(" invBgColor: 0x"));
+  Serial.println(invBgColor, HEX);
 #endif
 
-    switch (type) {
-    case RECTANGLE_ROUNDED:
-  	  Screen.fillRoundRect(x, y, width, height, RECTANGLE_RADIUS, invStrokeColor);
-  	  break;
-
-    case RECTANGLE_SQUARE:
-    default:
-  	  Screen.fillRect(x, y, width, height, invStrokeColor);
-    }
-  }
-
-  //
-  //  Fill up the inner rectangle
-  //
-  #if DEBUG
-    Serial.print(F("RectangleWidget::draw invBgColor: 0x"));
-    Serial.println(invBgColor, HEX);
-  #endif
-
-    switch(type) {
-    case RECTANGLE_ROUNDED:
-      Screen.fillRoundRect(x + stroke, y + stroke, width-2*stroke, height-2*stroke, RECTANGLE_RADIUS, invBgColor);
-      break;
-
-    case RECTANGLE_SQUARE:
-    default:
-      Screen.fillRect(x + stroke, y + stroke, width-2*stroke, height-2*stroke, invBgColor);
-    }
-
+  paint(invBgColor, invStrokeColor);
 }
 
 /*---------------------------------------------------------------------------------
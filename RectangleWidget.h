@@ -54,6 +54,9 @@
  *  R E C T A N G L E  W I D G E T
  *===========================================================================*/
 class  RectangleWidget : public Widget {
+  protected:
+    void         paint(uint16_t fillColor, uint16_t edgeColor); // Paint every pixel once
+
   public:
 	uint16_t  type;             // form factor
     uint16_t  stroke;           // Stroke size
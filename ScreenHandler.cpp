@@ -44,6 +44,9 @@
 #include <TerraBox_Widgets.h>
 #include <Calibrator.h>
 #include <Dump.h>
+#ifdef TERRABOX_HOST
+#include <FrameBufferDriver.h>
+#endif
 
 //#include <SoftKeyboardWidget.h>
 
@@ -51,6 +54,8 @@
 #define DEBUG_BEGIN	    0
 #define DEBUG_ON_EVENT  0
 
+#define CELLSIZE 20             // Distance in pixels between the calibration markers
+
 /*==============================================================================
  *
  * The Screen class is an abstraction of the physical screen.
@@ -61,25 +66,20 @@
  *
  * Create a screen handler
  *
- * pTft    The driver for the screen.
+ * pDriver    The driver for the screen.
  *
  *---------------------------------------------------------------------------*/
-ScreenHandler::ScreenHandler(MCUFRIEND_kbv* pTftScreen) 
-      : Widget(nullptr, 0, 0, pTftScreen->width(), pTftScreen->height()) {
+ScreenHandler::ScreenHandler(DisplayDriver* pDriver)
+      : Widget(nullptr, 0, 0, pDriver->getGfx()->width(), pDriver->getGfx()->height()) {
 
   strcpy(nameId, "Screen");
   widgetSize = sizeof(ScreenHandler);
 
   //
-  //  Remember the TFT screen driver.
-  //
-  tft             = pTftScreen;
-
-  //
-  //  Initialize the queue for dispatching later events
+  //  Remember the TFT screen driver and the GFX object it draws with.
   //
-  laterQueue     = nullptr;
-  laterQueueLast = nullptr;
+  driver          = pDriver;
+  tft             = pDriver->getGfx();
 
   //
   //  Add the keyboard to the widget tree.
@@ -110,7 +110,7 @@ void ScreenHandler::begin() {
 	  //
 	  // Initialize TFT screen
 	  //
-	  uint16_t ID = tft->readID();
+	  uint16_t ID = driver->readID();
 
 	  #if DEBUG_BEGIN
 	    Serial.print(F("ScreenHandler::begin ID = 0x"));
@@ -118,10 +118,11 @@ void ScreenHandler::begin() {
 	  #endif
 
 	  if (ID == 0xD3D3) ID = 0x9481; // write-only shield
-	  tft->begin(ID);
+	  driver->begin(ID);
 
 	  width  = tft->width();
 	  height = tft->height();
+	  Touch.setRotation(tft->getRotation());
 
 	  tft->fillScreen(BLACK);
 
@@ -150,12 +151,78 @@ void ScreenHandler::beginFull() {
   //
   begin();
 
+  splashAndCalibrate();
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  beginFull() after the TFT is initialized: show the splash screen, wait for
+ *  a tap that requests a recalibration and calibrate.
+ *
+ *----------------------------------------------------------------------------*/
+void ScreenHandler::splashAndCalibrate() {
+
+  if (beginSplash()) {
+    completeBegin(Touch.tapOrTimeout((unsigned long)6000));
+  }
+  //
+  // Otherwise show the splash screen for 3 seconds
+  //
+  else {
+    delay(3000);
+    completeBegin(false);
+  }
+}
+
+/**----------------------------------------------------------------------------
+ *
+ *  Does the same as beginFull(), but returns while waiting for the tap that
+ *  requests a recalibration. The wait is performed by the TapWait task, so
+ *  schedule it, or call TapWait.exec() from loop(). Meanwhile setup() can
+ *  continue initialising the rest. When the screen is ready, ready() is
+ *  called.
+ *
+ *  ready      Called when the screen is ready, may be nullptr
+ *
+ *---------------------------------------------------------------------------*/
+void ScreenHandler::beginFullAsync(void (*ready)()) {
+
+  begin();
+
+  beginReady = ready;
+  beginAsk   = beginSplash();
+
+  if (!TapWait.start(beginAsk ? 6000 : 3000, beginTapped, beginAsk)) {
+    beginTapped(false);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Completion of the tap wait started by beginFullAsync(). Only while asking
+ *  for it, a tap triggers the recalibration.
+ *
+ *----------------------------------------------------------------------------*/
+void ScreenHandler::beginTapped(bool tapped) {
+
+  Screen.completeBegin(tapped && Screen.beginAsk);
+
+  if (Screen.beginReady)
+    Screen.beginReady();
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  First part of beginFull(), after the TFT is initialized: show the splash
+ *  screen. Returns true if the user is asked to tap for a recalibration.
+ *
+ *----------------------------------------------------------------------------*/
+bool ScreenHandler::beginSplash() {
+
   //=============================================================================
   //  Start up the screen and calibration
   //=============================================================================
-  #define CELLSIZE 20
-
-  Screen.tft->setRotation(0);
+  Screen.setRotation(0);
  
   //
   // Create the calibrator.
@@ -200,15 +267,28 @@ void ScreenHandler::beginFull() {
       Screen.tft->print(  F("  ... "));
     }
 
-    if (Touch.tapOrTimeout((unsigned long)6000)) {
-      calibrator.recalibrate();
-    }
+    return true;
   }
-  //
-  // Otherwise show the splash screen for 3 seconds
-  //
-  else {
-    delay(3000);
+
+  return false;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Last part of beginFull(): clear the splash screen and calibrate. Without
+ *  a recalibration the persisted calibration is used.
+ *
+ *  recalibrate  true: the TFT is calibrated again
+ *
+ *----------------------------------------------------------------------------*/
+void ScreenHandler::completeBegin(bool recalibrate) {
+
+  Calibrator calibrator(nullptr, Screen.tft->width(), Screen.tft->height(), CELLSIZE);
+  calibrator.meshCalibration = calibrateMesh;
+  calibrator.affinePoints    = calibrationPoints;
+
+  if (recalibrate) {
+    calibrator.recalibrate();
   }
 
   //
@@ -219,18 +299,20 @@ void ScreenHandler::beginFull() {
   //
   // Set the rotation back to what we need, since the splash screen changes it
   //
-  Screen.tft->setRotation(0);
+  Screen.setRotation(0);
 
   //
-  // Allocate the marker calibration buffers
+  // Allocate the marker calibration buffers, they are kept for a recalibration
   //
-  uint16_t xMarkerBuffer = calibrator.getXAxisBuffer();
-  uint16_t yMarkerBuffer = calibrator.getYAxisBuffer();
+  if (!xCalibrationBuffer) {
+    xCalibrationBuffer = calibrator.getXAxisBuffer();
+    yCalibrationBuffer = calibrator.getYAxisBuffer();
+  }
 
   //
   //  Start the calibration procedure
   //
-  calibrator.calibrate(xMarkerBuffer, yMarkerBuffer);
+  calibrator.calibrate(xCalibrationBuffer, yCalibrationBuffer);
 
   calibrator.diagnostics();
 
@@ -246,6 +328,103 @@ void ScreenHandler::beginFull() {
 //  draw();
 }
 
+/**----------------------------------------------------------------------------
+ *
+ *  Fast start up for a calibrated unit. If the persisted calibration is valid,
+ *  it is installed right away, without the splash screen, the tap to
+ *  recalibrate and the diagnostics.
+ *
+ *  If the calibration is missing, outdated or corrupt it falls back to
+ *  beginFull(), without initializing the TFT again.
+ *
+ *  longPress    true: a long press on the screen background recalibrates,
+ *               this enables the gestures of the TouchHandler
+ *
+ *  Returns true if the fast start up succeeded.
+ *
+ *  Example:
+ *  ------------------------------------
+ *  setup () {
+ *      Screen.beginFast();
+ *      // Create the widgets
+ *  }
+ *
+ *---------------------------------------------------------------------------*/
+bool ScreenHandler::beginFast(bool longPress) {
+
+  begin();
+  setRotation(0);
+
+  Calibrator calibrator(nullptr, tft->width(), tft->height(), CELLSIZE);
+
+  if (!xCalibrationBuffer) {
+    xCalibrationBuffer = calibrator.getXAxisBuffer();
+    yCalibrationBuffer = calibrator.getYAxisBuffer();
+  }
+
+  if (isPersistentStorageVirgin() ||
+      !calibrator.loadCalibration(xCalibrationBuffer, yCalibrationBuffer)) {
+    splashAndCalibrate();
+    return false;
+  }
+
+  if (longPress) {
+    recalibrateOnLongPress = true;
+    Touch.gestures.enabled = true;
+  }
+
+  return true;
+}
+
+/**----------------------------------------------------------------------------
+ *
+ *  Calibrates the touch panel again and then draws the widgets. This takes
+ *  over the screen and the touches until the calibration is done, but it does
+ *  not block. The calibration is driven by the Touch task.
+ *
+ *---------------------------------------------------------------------------*/
+void ScreenHandler::recalibrate() {
+
+  if (Touch.rawSampleSink)
+    return;
+
+  recalibrationRotation = tft->getRotation();
+  setRotation(0);
+
+  Calibrator* calibrator = new Calibrator(nullptr, tft->width(), tft->height(), CELLSIZE);
+  calibrator->meshCalibration = calibrateMesh;
+  calibrator->affinePoints    = calibrationPoints;
+
+  if (!xCalibrationBuffer) {
+    xCalibrationBuffer = calibrator->getXAxisBuffer();
+    yCalibrationBuffer = calibrator->getYAxisBuffer();
+  }
+
+  if (!calibrator->start(xCalibrationBuffer, yCalibrationBuffer, recalibrated)) {
+    delete calibrator;
+    setRotation(recalibrationRotation);
+  }
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Completion of the calibration started by recalibrate().
+ *
+ *----------------------------------------------------------------------------*/
+void ScreenHandler::recalibrated(Calibrator* calibrator) {
+
+  delete calibrator;
+
+  //
+  // The touch that requested it is over, forget it
+  //
+  Touch.gestures.reset();
+  Touch.filter.reset();
+
+  Screen.setRotation(Screen.recalibrationRotation);
+  Screen.draw();
+}
+
 /**----------------------------------------------------------------------------
  *
  *  Start up and show EEPROM memory
@@ -268,7 +447,7 @@ void ScreenHandler::analyzeEEPROM() {
       //
 	  //
 	  //
-	  Screen.tft->setRotation(0);
+	  Screen.setRotation(0);
 
 	  //
 	  // Create the calibrator.
@@ -368,6 +547,282 @@ void ScreenHandler::redraw( ){
 
 }
 
+/*------------------------------------------------------------------------------
+ *
+ *  Marks a region of the screen as damaged. The region is repainted at the
+ *  next frame by repaint(). Overlapping and touching regions are merged.
+ *  If all damage slots are in use, the region is merged with the damaged
+ *  region that grows the least by doing so.
+ *
+ *  pX           X coordinate of the damaged area
+ *  pY           Y coordinate of the damaged area
+ *  pWidth       The width of the damaged area
+ *  pHeight      The height of the damaged area
+ *
+ *----------------------------------------------------------------------------*/
+void ScreenHandler::addDamage(int16_t pX, int16_t pY, uint16_t pWidth, uint16_t pHeight) {
+
+  //
+  //  Clip the region to the screen
+  //
+  int16_t x1 = pX < 0 ? 0 : pX;
+  int16_t y1 = pY < 0 ? 0 : pY;
+  int16_t x2 = pX + pWidth;
+  int16_t y2 = pY + pHeight;
+
+  if (x2 > (int16_t)width)
+	x2 = width;
+  if (y2 > (int16_t)height)
+	y2 = height;
+
+  //
+  //  Nothing left of it, then there is no damage
+  //
+  if (x1 >= x2 || y1 >= y2)
+	return;
+
+  //
+  //  No free slot left, so grow the region which grows the least
+  //
+  if (damageCount >= SCREEN_DAMAGE_SIZE) {
+
+	uint8_t  best       = 0;
+	uint32_t bestGrowth = 0xffffffff;
+
+	for (uint8_t i = 0; i < damageCount; i++) {
+	  Region* r = &damage[i];
+
+	  uint32_t ux1 = min(r->x1, x1);
+	  uint32_t uy1 = min(r->y1, y1);
+	  uint32_t ux2 = max(r->x2, x2);
+	  uint32_t uy2 = max(r->y2, y2);
+
+	  uint32_t growth = (ux2 - ux1) * (uy2 - uy1)
+			          - (uint32_t)(r->x2 - r->x1) * (uint32_t)(r->y2 - r->y1);
+
+	  if (growth < bestGrowth) {
+		bestGrowth = growth;
+		best       = i;
+	  }
+	}
+
+	Region* r = &damage[best];
+	r->x1 = min(r->x1, x1);
+	r->y1 = min(r->y1, y1);
+	r->x2 = max(r->x2, x2);
+	r->y2 = max(r->y2, y2);
+
+	mergeDamage(best);
+	return;
+  }
+
+  //
+  //  Add it as a new damaged region and merge it with the existing ones
+  //
+  Region* r = &damage[damageCount];
+  r->x1 = x1;
+  r->y1 = y1;
+  r->x2 = x2;
+  r->y2 = y2;
+
+  mergeDamage(damageCount++);
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Merges the damaged region at the index with all regions it overlaps or
+ *  touches. Merged regions are removed from the damage list, by moving the
+ *  last region into the freed slot.
+ *
+ *  index        The index of the region to merge
+ *
+ *----------------------------------------------------------------------------*/
+void ScreenHandler::mergeDamage(uint8_t index) {
+
+  bool merged = true;
+  while (merged) {
+
+	merged = false;
+	for (uint8_t i = 0; i < damageCount; i++) {
+
+	  if (i == index)
+		continue;
+
+	  Region* a = &damage[index];
+	  Region* b = &damage[i];
+
+	  //
+	  //  Skip regions which neither overlap nor touch
+	  //
+	  if (a->x1 > b->x2 || b->x1 > a->x2 || a->y1 > b->y2 || b->y1 > a->y2)
+		continue;
+
+	  //
+	  //  Grow region a so it covers region b as well
+	  //
+	  a->x1 = min(a->x1, b->x1);
+	  a->y1 = min(a->y1, b->y1);
+	  a->x2 = max(a->x2, b->x2);
+	  a->y2 = max(a->y2, b->y2);
+
+	  //
+	  //  Remove region b, if a happened to be the last one it moves into slot i
+	  //
+	  damage[i] = damage[--damageCount];
+	  if (index == damageCount)
+		index = i;
+
+	  merged = true;
+	  break;
+	}
+  }
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Returns true if the widget intersects one of the damaged regions.
+ *
+ *  w            The widget to check
+ *
+ *----------------------------------------------------------------------------*/
+bool ScreenHandler::isDamaged(Widget* w) {
+
+  for (uint8_t i = 0; i < damageCount; i++) {
+	Region* r = &damage[i];
+
+	if (w->x < r->x2 && w->x + (int16_t)w->width  > r->x1 &&
+		w->y < r->y2 && w->y + (int16_t)w->height > r->y1)
+	  return true;
+  }
+
+  return false;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Returns true if some screen region is waiting to be repainted.
+ *
+ *----------------------------------------------------------------------------*/
+bool ScreenHandler::hasDamage() {
+  return damageCount > 0;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Repaints the damaged screen regions, this is the end of a frame.
+ *  Only the widgets intersecting the damage are redrawn. Damage not covered
+ *  by a widget is cleared to the screen background color.
+ *
+ *  It is called by the TouchHandler after every poll for touches. If you do
+ *  not schedule the TouchHandler as a Task, call it from within loop().
+ *
+ *----------------------------------------------------------------------------*/
+void ScreenHandler::repaint() {
+
+  if (!damageCount)
+	return;
+
+  //
+  //  A sleeping screen is fully redrawn on wake up, so forget the damage
+  //
+  if (!isVisible()) {
+	damageCount = 0;
+	return;
+  }
+
+  //
+  //  A widget is always drawn in full. So its entire area becomes damaged,
+  //  otherwise it might paint over an overlapping widget that is higher in
+  //  the z-order. Repeat until the damage does not grow anymore.
+  //
+  bool grown = true;
+  while (grown) {
+
+	grown = false;
+	for (Widget* w = child; w; w = w->getSibling()) {
+
+	  if (!w->isVisible() || !isDamaged(w))
+		continue;
+
+	  //
+	  //  Is it already covered by a single damaged region?
+	  //
+	  bool covered = false;
+	  for (uint8_t i = 0; i < damageCount && !covered; i++) {
+		Region* r = &damage[i];
+		covered = w->x >= r->x1 && w->x + (int16_t)w->width  <= r->x2 &&
+				  w->y >= r->y1 && w->y + (int16_t)w->height <= r->y2;
+	  }
+
+	  if (!covered) {
+		addDamage(w->x, w->y, w->width, w->height);
+		grown = true;
+	  }
+	}
+  }
+
+  //
+  //  Clear the damaged regions, but only if no single widget paints it anyway
+  //
+  for (uint8_t i = 0; i < damageCount; i++) {
+	Region* r = &damage[i];
+
+	bool covered = false;
+	for (Widget* w = child; w && !covered; w = w->getSibling()) {
+	  covered = w->isVisible() &&
+			    w->x <= r->x1 && w->x + (int16_t)w->width  >= r->x2 &&
+			    w->y <= r->y1 && w->y + (int16_t)w->height >= r->y2;
+	}
+
+	//
+	//  Through fillRect(), so that in a recorded frame the clear stays in
+	//  order with the commands recorded before it
+	//
+	if (!covered)
+	  fillRect(r->x1, r->y1, r->x2 - r->x1, r->y2 - r->y1, BLACK);
+  }
+
+  //
+  //  Redraw the damaged widgets in the same order as draw() does
+  //
+  for (Widget* w = child; w; w = w->getSibling()) {
+	if (w->isVisible() && isDamaged(w))
+	  w->redraw();
+  }
+
+  damageCount = 0;
+
+  //
+  //  A recorded frame is only drawn by endFrame()
+  //
+  if (!displayList.recording)
+	latency.frameFinished();
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Handle LONG_PRESS events for the screen. Long presses of widgets are
+ *  passed on to the screen too, only one on the background recalibrates.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void ScreenHandler::onLongPress(TouchEvent* event) {
+
+  if (recalibrateOnLongPress && event->source == this)
+    recalibrate();
+}
+
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Handle DRIFT events, the touches are off the buttons by event->x and
+ *  event->y pixels. Recalibrates if recalibrateOnDrift is set.
+ *
+ *------------------------------------------------------------------------------------------------*/
+void ScreenHandler::onDrift(TouchEvent* event) {
+
+  if (recalibrateOnDrift)
+    recalibrate();
+}
+
 /*--------------------------------------------------------------------------------------------------
  *
  *  Handle TOUCH events for the screen.
@@ -434,16 +889,20 @@ void ScreenHandler::onWakeUp(TouchEvent* event) {
  *  Try to match a widget based on the coordinates.
  *  If the X, Y fall in the area occupied by the widget,
  *  then here is a match.
+ *  If the spatial index is enabled (see Screen.index.begin()) it is used,
+ *  otherwise the widget tree is walked by Widget::match().
  *
- *  event      The event to be matched
+ *  x          The x coordinate to be matched
+ *  y          The y coordinate to be matched
  *
+ *----------------------------------------------------------------------------*/
 Widget* ScreenHandler::match(int16_t x, int16_t y) {
 #if DEBUG_MATCH
   Serial.print(F("ScreenHandler::dispatch match widget on (x, y) : "));
   Serial.print(x); Serial.print(F(","));Serial.println(y);
 #endif
 
-  Widget* widget = Widget::match(x, y);
+  Widget* widget = index.isEnabled() ? index.match(x, y) : Widget::match(x, y);
 
   //
   // If a widget was not found, then return no object
@@ -458,7 +917,6 @@ Widget* ScreenHandler::match(int16_t x, int16_t y) {
 
   return widget;
 }
- *----------------------------------------------------------------------------*/
 
 /*-----------------------------------------------------------------------------------------
  *
@@ -472,13 +930,14 @@ Widget* ScreenHandler::dispatch(TouchEvent* event) {
   //
   //  Executed the event passed
   //
-  dispatchOnly(event);
+  Widget* widget = dispatchOnly(event);
 
   //
   //  Empty the event queue with later events
   //
   dispatchAll();
 
+  return widget;
 }
 
 /*-----------------------------------------------------------------------------------------
@@ -504,9 +963,12 @@ Widget* ScreenHandler::dispatchOnly(TouchEvent* event) {
   // If a widget was not found, then send it to the unsollicited event handler
   // and return no object
   //
+  latency.dispatchStarted(event);
+
   if (! event->source) {
 
     onUnsollicitedEvent(event);
+    latency.dispatchFinished();
     return nullptr;
 
   }
@@ -538,6 +1000,8 @@ Widget* ScreenHandler::dispatchOnly(TouchEvent* event) {
     Serial.println(F("ScreenHandler::dispatch *** Finished *** event dispatching"));
   #endif
 
+  latency.dispatchFinished();
+
   //
   // Return the matched widget
   //
@@ -551,23 +1015,16 @@ Widget* ScreenHandler::dispatchOnly(TouchEvent* event) {
  *------------------------------------------------------------------------------------------------*/
 boolean ScreenHandler::dispatch() {
 
-  if (!laterQueue) {
+  //
+  //  The event is copied out of the queue, so its slot is free again
+  //  before it is dispatched.
+  //
+  TouchEvent event;
+  if (!laterQueue.pop(&event)) {
     return false;
   }
 
-  TouchEventLink* link = laterQueue;
-  laterQueue->remove();
-  laterQueue = link->getNext();
-
-  if (link->getEvent()) {
-    dispatch(link->getEvent());
-  }
-
-  link->setPrev(nullptr);
-  link->setEvent(nullptr);
-  link->setNext(nullptr);
-
-  delete link;
+  dispatch(&event);
   return true;
 }
 
@@ -602,26 +1059,16 @@ void ScreenHandler::dispatchAll() {
  *       later event execution is basically spread in time evenly, which is positive in
  *       spreading system load.
  *
+ *  The event is copied into a fixed size queue, so the caller may reuse or release it
+ *  right away. If the queue is full, the drop policy of the queue decides which event
+ *  is lost. See TouchEventQueue.
+ *
  *  event      The event to dispatch a later point in time.
  *
  *------------------------------------------------------------------------------------------------*/
 void ScreenHandler::dispatchLater(TouchEvent* event) {
 
-  //
-  // If no later event, then add the first event
-  //
-  if (! laterQueueLast) {
-
-    TouchEventLink* link = new TouchEventLink(nullptr, event, nullptr);
-    laterQueue           = link;
-    laterQueueLast       = link;
-    return;
-  } 
-
-  //
-  // Add a later event at the end of the queue
-  //
-  laterQueueLast = laterQueueLast->append(event);
+  laterQueue.push(event);
 }
 
 /*-------------------------------------------------------------
@@ -686,7 +1133,13 @@ void ScreenHandler::fillRect( int16_t x,      int16_t y,
 	if (!isVisible())
 		return;
 
+	if (displayList.recording) {
+		displayList.add(DL_FILL_RECT, x, y, width, height, color, 0);
+		return;
+	}
+
 	tft->fillRect(x, y, width, height, color);
+	latency.drawn();
 }
 
 void ScreenHandler::fillRoundRect( int16_t x,       int16_t y,
@@ -697,7 +1150,13 @@ void ScreenHandler::fillRoundRect( int16_t x,       int16_t y,
 	if (!isVisible())
 		return;
 
+	if (displayList.recording) {
+		displayList.add(DL_FILL_ROUND_RECT, x, y, width, height, color, radius);
+		return;
+	}
+
     tft->fillRoundRect(x, y, width, height, radius, color);
+    latency.drawn();
 }
 
 void ScreenHandler::fillScreen(uint16_t color) {
@@ -706,7 +1165,13 @@ void ScreenHandler::fillScreen(uint16_t color) {
 	if (!isVisible())
 		return;
 
+	if (displayList.recording) {
+		displayList.add(DL_FILL_SCREEN, 0, 0, tft->width(), tft->height(), color, 0);
+		return;
+	}
+
     tft->fillScreen(color);
+    latency.drawn();
 }
 
 size_t ScreenHandler::print(char* s) {
@@ -715,7 +1180,7 @@ size_t ScreenHandler::print(char* s) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(s);
+	return printed(printer()->print(s));
 }
 
 
@@ -725,7 +1190,7 @@ size_t ScreenHandler::print(char c) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(c);
+	return printed(printer()->print(c));
 }
 
 size_t ScreenHandler::print(const __FlashStringHelper* s) {
@@ -734,7 +1199,7 @@ size_t ScreenHandler::print(const __FlashStringHelper* s) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(s);
+	return printed(printer()->print(s));
 }
 
 size_t ScreenHandler::print(const char* (&s)) {
@@ -743,7 +1208,7 @@ size_t ScreenHandler::print(const char* (&s)) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(s);
+	return printed(printer()->print(s));
 }
 
 size_t ScreenHandler::print(unsigned int j, int i = DEC) {
@@ -752,7 +1217,7 @@ size_t ScreenHandler::print(unsigned int j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(j, i);
+	return printed(printer()->print(j, i));
 }
 
 size_t ScreenHandler::print(int j, int i = DEC) {
@@ -760,7 +1225,7 @@ size_t ScreenHandler::print(int j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(j, i);
+	return printed(printer()->print(j, i));
 }
 
 size_t ScreenHandler::print(unsigned long j, int i = DEC) {
@@ -768,7 +1233,7 @@ size_t ScreenHandler::print(unsigned long j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(j, i);
+	return printed(printer()->print(j, i));
 }
 
 size_t ScreenHandler::print(long j, int i = DEC) {
@@ -776,7 +1241,7 @@ size_t ScreenHandler::print(long j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->print(j, i);
+	return printed(printer()->print(j, i));
 }
 
 size_t ScreenHandler::println() {
@@ -784,7 +1249,7 @@ size_t ScreenHandler::println() {
 	if (!isVisible())
 		return 0;
 
-	return tft->println();
+	return printed(printer()->println());
 }
 
 size_t ScreenHandler::println(char* s) {
@@ -792,7 +1257,7 @@ size_t ScreenHandler::println(char* s) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(s);
+	return printed(printer()->println(s));
 }
 
 
@@ -801,7 +1266,7 @@ size_t ScreenHandler::println(char c) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(c);
+	return printed(printer()->println(c));
 }
 
 size_t ScreenHandler::println(const __FlashStringHelper* s) {
@@ -809,7 +1274,7 @@ size_t ScreenHandler::println(const __FlashStringHelper* s) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(s);
+	return printed(printer()->println(s));
 }
 
 size_t ScreenHandler::println(const char* (&s)) {
@@ -817,7 +1282,7 @@ size_t ScreenHandler::println(const char* (&s)) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(s);
+	return printed(printer()->println(s));
 }
 
 size_t ScreenHandler::println(unsigned int j, int i = DEC) {
@@ -825,7 +1290,7 @@ size_t ScreenHandler::println(unsigned int j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(j, i);
+	return printed(printer()->println(j, i));
 }
 
 size_t ScreenHandler::println(int j, int i = DEC) {
@@ -833,7 +1298,7 @@ size_t ScreenHandler::println(int j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(j, i);
+	return printed(printer()->println(j, i));
 }
 
 size_t ScreenHandler::println(unsigned long j, int i = DEC) {
@@ -841,7 +1306,7 @@ size_t ScreenHandler::println(unsigned long j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(j, i);
+	return printed(printer()->println(j, i));
 }
 
 size_t ScreenHandler::println(long j, int i = DEC) {
@@ -849,7 +1314,7 @@ size_t ScreenHandler::println(long j, int i = DEC) {
 	if (!isVisible())
 		return 0;
 
-	return tft->println(j, i);
+	return printed(printer()->println(j, i));
 }
 
 /*
@@ -1026,26 +1491,48 @@ int16_t ScreenHandler::getRotation() {
   return tft->getRotation();
 }
 
+/*-----------------------------------------------------------------------------
+ *
+ *  Set the rotation of the screen and of the touches. Always use this instead
+ *  of tft->setRotation(), otherwise the touches keep the old rotation.
+ *
+ *---------------------------------------------------------------------------*/
 void ScreenHandler::setRotation(int16_t rotation) {
 
   tft->setRotation(rotation);
+  Touch.setRotation(rotation);
+}
+
+int16_t ScreenHandler::getTextSize() {
+
+	return displayList.textSize;
 }
 
 void ScreenHandler::setTextSize(int16_t size) {
 
 	tft->setTextSize(size);
+
+	displayList.textSize = size;
+	if (displayList.recording)
+		displayList.state();
 }
 
 void ScreenHandler::setCursor(int16_t x, int16_t y) {
 
     tft->setCursor(x, y);
+
+    displayList.cursorX   = x;
+    displayList.cursorY   = y;
+    displayList.cursorSet = true;
+	if (displayList.recording)
+		displayList.state();
 }
 
-void ScreenHandler::getTextBounds(char* s, int16_t x, int16_t y,
+void ScreenHandler::getTextBounds(const char* s, int16_t x, int16_t y,
 		            int16_t *xr,     int16_t *yr,
 		           uint16_t *width, uint16_t *height) {
 
-	tft->getTextBounds(s, x, y, xr, yr, width, height);
+	textMetrics.bounds(tft, getTextSize(), s, x, y, xr, yr, width, height);
 }
 
 void ScreenHandler::getTextBounds(String s, int16_t x, int16_t y,
@@ -1053,12 +1540,105 @@ void ScreenHandler::getTextBounds(String s, int16_t x, int16_t y,
 		           uint16_t *width, uint16_t *height) {
 
 
-	tft->getTextBounds(s, x, y, xr, yr, width, height);
+	textMetrics.bounds(tft, getTextSize(), s.c_str(), x, y, xr, yr, width, height);
 }
 
 void ScreenHandler::setTextColor(uint16_t color) {
 
     tft->setTextColor(color);
+
+	displayList.textColor   = color;
+	displayList.textBgColor = color;
+	if (displayList.recording)
+		displayList.state();
+}
+
+/*-------------------------------------------------------------
+ *
+ *  Sets the text color with an opaque background.
+ *  With the built-in font each printed character then paints
+ *  its entire cell, so no clearing is needed before printing.
+ *
+ *  color    The text color
+ *  bgColor  The background color
+ *
+ *-----------------------------------------------------------*/
+void ScreenHandler::setTextColor(uint16_t color, uint16_t bgColor) {
+
+    tft->setTextColor(color, bgColor);
+
+	displayList.textColor   = color;
+	displayList.textBgColor = bgColor;
+	if (displayList.recording)
+		displayList.state();
+}
+
+/*-------------------------------------------------------------
+ *
+ *  Returns where print() output goes: the display list while
+ *  recording a frame, otherwise the display itself.
+ *  Each printer() must be paired with a printed().
+ *
+ *-----------------------------------------------------------*/
+Print* ScreenHandler::printer() {
+
+	if (displayList.recording) {
+		displayList.beginText();
+		return &displayList;
+	}
+
+	return tft;
+}
+
+/*-------------------------------------------------------------
+ *
+ *  Finishes the output started with printer().
+ *
+ *  n      The number of characters printed
+ *
+ *-----------------------------------------------------------*/
+size_t ScreenHandler::printed(size_t n) {
+
+	if (displayList.recording)
+		displayList.endText();
+	else
+		latency.drawn();
+
+	return n;
+}
+
+/*-------------------------------------------------------------
+ *
+ *  Starts recording the drawing of a frame.
+ *  Until endFrame() fills and text are not sent to the display,
+ *  but recorded in the display list. See DisplayList.cpp.
+ *
+ *-----------------------------------------------------------*/
+void ScreenHandler::beginFrame() {
+
+	if (displayList.recording)
+		return;
+
+	displayList.begin(tft);
+}
+
+/*-------------------------------------------------------------
+ *
+ *  Ends the frame: the recorded drawing is optimized and sent
+ *  to the display. displayList.frameRecorded and frameEmitted
+ *  tell how many commands were saved.
+ *
+ *-----------------------------------------------------------*/
+void ScreenHandler::endFrame() {
+
+	if (!displayList.recording)
+		return;
+
+	displayList.end();
+
+	if (displayList.frameEmitted)
+		latency.drawn();
+	latency.frameFinished();
 }
 
 //
@@ -1066,7 +1646,12 @@ void ScreenHandler::setTextColor(uint16_t color) {
 //
 using namespace std;
 
-MCUFRIEND_kbv tftScreen;			// Create a driver for the screen
-ScreenHandler Screen(&tftScreen);	// Create Touch Screen encapsulation object.
+#ifndef TERRABOX_HOST
+MCUFRIEND_kbv   tftScreen;			// Create a driver for the screen
+McufriendDriver tftDriver(&tftScreen);	// Wrap it as the display driver
+#else
+FrameBufferDriver tftDriver(FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);	// RAM frame buffer on a PC
+#endif
+ScreenHandler Screen(&tftDriver);	// Create Touch Screen encapsulation object.
 
 
@@ -0,0 +1,225 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TapWaiter.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+#define TAP_IDLE          0           // Not waiting
+#define TAP_WAIT_TOUCH    1           // Waiting for the touch, or the timeout
+#define TAP_WAIT_RELEASE  2           // Touched, waiting for the release
+
+/*==============================================================================
+ *
+ *  Waits for a tap like waitForATap() and countDownWait() do, but without
+ *  blocking. Every exec() takes one raw touch sample and advances the wait,
+ *  when the tap is complete or the time is out the done() callback is
+ *  called. Raw samples are used, so it also works before the touch panel
+ *  is calibrated.
+ *
+ *  While waiting it also takes over the samples of the Touch task, like a
+ *  running calibration does. So Touch does not digest touches, possibly
+ *  without a calibration installed yet, and the tap is not dispatched to
+ *  the widgets too.
+ *
+ *  Schedule TapWait, or call TapWait.exec() from loop(). Example:
+ *
+ *    void tapped(bool yes) {
+ *      if (yes) ...
+ *    }
+ *
+ *    setup() {
+ *      ...
+ *      Touch.tapOrTimeout(6000, tapped);  // Or TapWait.start(6000, tapped)
+ *      // Continue initializing the sensors
+ *    }
+ *
+ *============================================================================*/
+
+/*------------------------------------------------------------------------------
+ *
+ *  Constructor
+ *
+ *----------------------------------------------------------------------------*/
+TapWaiter::TapWaiter() :
+           Task("TapWaiter", 20) {
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Start waiting for a tap.
+ *
+ *  pTimeout    ms to wait for the touch, 0 waits forever
+ *  pDone       Called with true when tapped, false when timed out
+ *  pCountDown  Print the seconds waited on the screen, like countDownWait()
+ *
+ *  Returns false if it is already waiting for a tap.
+ *
+ *----------------------------------------------------------------------------*/
+bool TapWaiter::start(unsigned long pTimeout, void (*pDone)(bool tapped), bool pCountDown) {
+
+  if (state != TAP_IDLE)
+    return false;
+
+  timeout   = pTimeout;
+  done      = pDone;
+  countDown = pCountDown;
+  counter   = 0;
+  tapped    = false;
+  started   = millis();
+  state     = TAP_WAIT_TOUCH;
+
+  if (!Touch.rawSampleSink)
+    Touch.rawSampleSink = forward;
+
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Stop waiting, done() is not called.
+ *
+ *----------------------------------------------------------------------------*/
+void TapWaiter::cancel() {
+  state = TAP_IDLE;
+  release();
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  True while waiting for the tap.
+ *
+ *----------------------------------------------------------------------------*/
+bool TapWaiter::isWaiting() {
+  return state != TAP_IDLE;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  End the wait and report the result. The state is reset first, so done()
+ *  can start a new wait.
+ *
+ *----------------------------------------------------------------------------*/
+void TapWaiter::finish(bool pTapped) {
+
+  state  = TAP_IDLE;
+  tapped = pTapped;
+  release();
+
+  if (done)
+    done(pTapped);
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Gives the samples of the Touch task back, if the wait took them over.
+ *
+ *----------------------------------------------------------------------------*/
+void TapWaiter::release() {
+  if (Touch.rawSampleSink == forward)
+    Touch.rawSampleSink = nullptr;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Passes the samples of the Touch task to the wait.
+ *
+ *----------------------------------------------------------------------------*/
+void TapWaiter::forward(XY* /* raw */, bool pressed, unsigned long /* now */) {
+  TapWait.sample(pressed);
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Take one sample and advance the wait.
+ *
+ *----------------------------------------------------------------------------*/
+void TapWaiter::exec() {
+
+  if (state == TAP_IDLE)
+    return;
+
+  XY xy;
+  sample(getRawTouchData(&xy));
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Advance the wait with a sample.
+ *
+ *  pressed     true if the panel is touched
+ *
+ *----------------------------------------------------------------------------*/
+void TapWaiter::sample(bool pressed) {
+
+  switch (state) {
+
+    case TAP_WAIT_TOUCH: {
+      if (pressed) {
+        state = TAP_WAIT_RELEASE;
+        break;
+      }
+
+      unsigned long waiting = millis() - started;
+
+      //
+      // Count the seconds down
+      //
+      if (countDown && waiting >= (unsigned long)(counter + 1) * 1000) {
+        Screen.tft->print(++counter);
+        Screen.tft->print(F(" "));
+      }
+
+      if (timeout && waiting >= timeout)
+        finish(false);
+      break;
+    }
+
+    //
+    // Wait for high/low edge
+    //
+    case TAP_WAIT_RELEASE:
+      if (!pressed)
+        finish(true);
+      break;
+  }
+}
+
+TapWaiter TapWait;	// Waits for taps without blocking
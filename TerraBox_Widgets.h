@@ -51,8 +51,16 @@
 
 //#include <SPI.h>          // f.k. for Arduino-1.5.2
 #include <Adafruit_GFX.h> // Hardware-specific library
+
+//
+//  Define TERRABOX_HOST when building the library on a PC.
+//  The TFT shield and the resistive touch panel are then replaced
+//  by a RAM frame buffer, see FrameBufferDriver.h
+//
+#ifndef TERRABOX_HOST
 #include <MCUFRIEND_kbv.h>
 #include <TouchScreen.h>
+#endif
 #include <TaskScheduler.h>
 
 #define MINPRESSURE 200
@@ -80,14 +88,35 @@
           int16_t  x;
           int16_t  y;
           int16_t  z;  // Pressure
+          uint32_t stamp; // micros() at which the sample was taken
+
+         };
+
+        /*-----------------------------------------------------------------
+        *
+        *  Little struct describing a rectangular screen region.
+        *  The upper left corner (x1, y1) is part of the region, the lower
+        *  right corner (x2, y2) is just outside of it.
+        *
+        *-----------------------------------------------------------------*/
+        struct  Region {
+
+          int16_t  x1;
+          int16_t  y1;
+          int16_t  x2;
+          int16_t  y2;
 
          };
 
          extern bool        getTouchData(XY* data);
          extern bool        getRawTouchData(XY* data);
+         extern bool        readTouchPanel(XY* data);
+         extern bool        (*rawTouchSource)(XY* data); // Replaces the touch panel, e.g. by a mock
          extern void        waitForATap();
          extern bool        countDownWait(uint16_t seconds);
+#ifndef TERRABOX_HOST
          extern TouchScreen ts;
+#endif
 
 /////                                                                          /////
 /////                                                                          /////
@@ -201,6 +230,14 @@ class TouchEvents {
     static const uint16_t WAKEUP              = 7;  // Wake up event
     static const uint16_t IN_SCOPE            = 8;  // A touch was detected in of scope of a widget, which was formerly out of scope.
     static const uint16_t OUT_OF_SCOPE        = 9;  // A touch was detected out of scope for a formerly in scope widget.
+    static const uint16_t LONG_PRESS          = 10; // The screen is touched at the same spot for a while
+    static const uint16_t DOUBLE_TAP          = 11; // Two short taps at the same spot in quick succession
+    static const uint16_t SWIPE_LEFT          = 12; // A quick stroke to the left, ended by lifting
+    static const uint16_t SWIPE_RIGHT         = 13; // A quick stroke to the right, ended by lifting
+    static const uint16_t SWIPE_UP            = 14; // A quick stroke upwards, ended by lifting
+    static const uint16_t SWIPE_DOWN          = 15; // A quick stroke downwards, ended by lifting
+    static const uint16_t DRAG                = 16; // The touch moves, the event carries its velocity
+    static const uint16_t DRIFT               = 17; // The touches are off the buttons, x and y hold by how many pixels
 };
 
 /*============================================================================
@@ -217,9 +254,14 @@ class TouchEvent {
     int16_t       x;		// X Screen coordinate of the touch
     int16_t       y;		// Y Screen coordinate of the touch
     EventSource*  source;		// The source of the event.
+    uint32_t      rawStamp;	// micros() of the raw touch sample, 0 if unknown
+    int16_t       vx;		// X velocity in pixels per second, DRAG and SWIPE events only
+    int16_t       vy;		// Y velocity in pixels per second, DRAG and SWIPE events only
 
     bool          passOn;		// True if the event must be passed on to the parent
 
+    TouchEvent();
+
     TouchEvent(
                uint16_t      pEvent,
                unsigned long timeStamp,
@@ -284,6 +326,74 @@ class TouchEventLink {
     void            setEvent(TouchEvent* event);
 };
 
+/*============================================================================
+ *  T O U C H  E V E N T  Q U E U E
+ *===========================================================================*/
+#ifndef TOUCH_EVENT_QUEUE_SIZE
+#define TOUCH_EVENT_QUEUE_SIZE  8     // Capacity in events, must be a power of two <= 128
+#endif
+
+#define QUEUE_DROP_NEWEST       0     // A full queue refuses the new event
+#define QUEUE_DROP_OLDEST       1     // A full queue discards its oldest event
+
+class TouchEventQueue {
+
+  private:
+    TouchEvent        events[TOUCH_EVENT_QUEUE_SIZE];  // The events, stored by value
+    volatile uint8_t  head      = 0;  // Free running index of the next free slot
+    volatile uint8_t  tail      = 0;  // Free running index of the oldest event
+
+  public:
+    uint8_t   dropPolicy        = QUEUE_DROP_NEWEST;  // What to do if the queue is full
+    uint16_t  overflows         = 0;  // Number of pushes on a full queue
+    uint16_t  dropped           = 0;  // Number of events lost due to overflows
+    uint8_t   highWater         = 0;  // Highest number of queued events so far
+
+    TouchEventQueue();
+
+    bool      push(TouchEvent* event);  // Copy an event into the queue
+    bool      pop(TouchEvent* event);   // Copy the oldest event out of the queue
+    uint8_t   size();                   // Number of queued events
+    bool      isEmpty();                // True if no events are queued
+    void      clear();                  // Discard all queued events
+    void      resetStatistics();        // Zero the overflow counters and high water mark
+};
+
+/*============================================================================
+ *  T O U C H  E V E N T  P O O L
+ *===========================================================================*/
+#ifndef TOUCH_EVENT_POOL_SIZE
+#define TOUCH_EVENT_POOL_SIZE   8     // Number of pooled events, at most 16
+#endif
+
+class TouchEventPool {
+
+  private:
+    TouchEvent  events[TOUCH_EVENT_POOL_SIZE];  // The pooled events
+    uint16_t    usedMask        = 0;  // Bit i is set if events[i] is acquired
+
+  public:
+    uint8_t     inUse           = 0;  // Number of events currently acquired
+    uint8_t     highWater       = 0;  // Highest number of events acquired at once
+    uint32_t    acquired        = 0;  // Total number of successful acquires
+    uint16_t    failures        = 0;  // Number of acquires on an exhausted pool
+
+    TouchEventPool();
+
+    TouchEvent* acquire(                // Acquire and initialize an event
+                    uint16_t      pEvent,
+                    unsigned long timeStamp,
+                    int16_t       pX,
+                    int16_t       pY,
+                    EventSource*  source);
+    TouchEvent* copy(TouchEvent* event);// Acquire an owned copy of an event
+    void        release(TouchEvent* e); // Return an event to the pool
+    bool        owns(TouchEvent* e);    // True if the event belongs to the pool
+    void        resetStatistics();      // Zero the counters and high water mark
+};
+
+extern TouchEventPool EventPool;
+
 /*============================================================================
  *  A R E A
  *===========================================================================*/
@@ -320,7 +430,7 @@ class Area : public EventSource {
     const   XY*  getUL( );
     const   XY*  getLR( );
     virtual void setPosition(int16_t pX, int16_t pY);
-            void move(int16_t deltaX, int16_t deltaY);
+    virtual void move(int16_t deltaX, int16_t deltaY);
             void center(int16_t ulX, int16_t ulY, int16_t lrX, int16_t lrY);
 
     //
@@ -351,6 +461,7 @@ class Widget : public Area {
     //
     bool     visible  = false;
     bool     inverted = false;
+    uint32_t pixelsWritten = 0;  // Pixels written by fill(), to check for overdraw
 
     //
     //  Widget tree
@@ -367,12 +478,12 @@ class Widget : public Area {
              Widget(Widget* parent,
                  int16_t  px,     int16_t  py, 
                  uint16_t pwidth, uint16_t pheight);
-//    virtual ~Widget();
+    virtual ~Widget();
 
     //
     //  Positions
     //
-//    void            move(int16_t deltaX, int16_t deltaY);
+    virtual void    move(int16_t deltaX, int16_t deltaY);
 //    void            setPosition(int16_t pX, int16_t pY);
 //    void            center(int16_t ulX, int16_t ulY, int16_t llX, int16_t llY);
 
@@ -402,12 +513,21 @@ class Widget : public Area {
     //  Visualization
     //
     virtual void    clear();
+            void    fill(int16_t  pX,     int16_t  pY,   // Fill a rectangle and count its pixels
+                         uint16_t pWidth, uint16_t pHeight,
+                         uint16_t color);
     virtual void    draw()         = 0;
     virtual void    drawInverted() = 0;
     virtual bool    isVisible();
     virtual void    redraw()       = 0;
     virtual void    setVisible(bool visible);
 
+    //
+    //  Damage tracking, the invalidated area is repainted at the next frame
+    //
+            void    invalidate();
+            void    invalidate(int16_t pX, int16_t pY, uint16_t pWidth, uint16_t pHeight);
+
     //
     // Touch function which are not screen agnostic.
     //
@@ -422,6 +542,11 @@ class Widget : public Area {
     virtual void    onWakeUp(TouchEvent* event);
     virtual void    onInScope(TouchEvent* event);
     virtual void    onOutOfScope(TouchEvent* event);
+    virtual void    onLongPress(TouchEvent* event);
+    virtual void    onDoubleTap(TouchEvent* event);
+    virtual void    onSwipe(TouchEvent* event);
+    virtual void    onDrag(TouchEvent* event);
+    virtual void    onDrift(TouchEvent* event);
 
     virtual void    tree();
     virtual void    tree(int level);
@@ -432,6 +557,44 @@ class Widget : public Area {
 
 };
 
+/*============================================================================
+ *  W I D G E T  I N D E X
+ *===========================================================================*/
+#ifndef WIDGET_INDEX_CELL_SIZE
+#define WIDGET_INDEX_CELL_SIZE   32   // Width and height of a grid cell in pixels
+#endif
+#define WIDGET_INDEX_MAX_WIDGETS 64   // Maximum number of indexed widgets, one bit each
+#define WIDGET_INDEX_ROOT        0xFF // Table index standing for the root widget
+
+class WidgetIndex {
+
+  private:
+    Widget*   root     = nullptr;     // The root of the indexed widget tree
+    Widget**  widgets  = nullptr;     // Indexed widgets in pre-order, i.e. match() order
+    uint8_t*  parents  = nullptr;     // Per indexed widget the table index of its parent
+    uint64_t* cells    = nullptr;     // Per cell a bit mask of the widgets overlapping it
+    uint16_t  capacity = 0;           // Number of allocated cells
+    uint8_t   columns  = 0;           // Number of grid columns
+    uint8_t   rows     = 0;           // Number of grid rows
+    uint8_t   count    = 0;           // Number of indexed widgets
+    bool      dirty    = true;        // True if the index must be rebuilt
+    bool      overflow = false;       // True if the tree did not fit the index
+
+    void      collect(Widget* w, uint8_t parent); // Add a subtree to the widget table
+    void      rebuild();              // Rebuild the index from the widget tree
+
+  public:
+    uint32_t  rebuilds  = 0;          // Number of times the index was rebuilt
+    uint32_t  queries   = 0;          // Number of queries answered by the index
+    uint32_t  fallbacks = 0;          // Number of queries answered by Widget::match()
+
+    bool      begin(Widget* pRoot);   // Enable the index for a widget tree
+    void      end();                  // Disable the index and free its memory
+    bool      isEnabled();            // True if the index is enabled
+    void      invalidate();           // The widget tree changed, rebuild at the next query
+    Widget*   match(int16_t pX, int16_t pY); // Topmost visible widget at (x, y)
+};
+
 /*============================================================================
  *  S P L A S H
  *===========================================================================*/
@@ -449,26 +612,280 @@ class Splash : public Widget {
     virtual const char* isType();
 };
 
+/*============================================================================
+ *  D I S P L A Y  D R I V E R
+ *===========================================================================*/
+class DisplayDriver {
+  public:
+    virtual ~DisplayDriver() {}                   // Deleted through a DisplayDriver pointer
+
+    virtual Adafruit_GFX* getGfx()           = 0;  // The GFX object doing the actual drawing
+    virtual uint16_t      readID()           = 0;  // Read the ID of the display controller
+    virtual void          begin(uint16_t ID) = 0;  // Initialize the display controller
+
+    virtual const char*   isType();
+};
+
+#ifndef TERRABOX_HOST
+/*============================================================================
+ *  M C U F R I E N D  D R I V E R
+ *===========================================================================*/
+class McufriendDriver : public DisplayDriver {
+  private:
+    MCUFRIEND_kbv* tft;
+
+  public:
+    McufriendDriver(MCUFRIEND_kbv* pTft);
+
+    virtual Adafruit_GFX* getGfx();
+    virtual uint16_t      readID();
+    virtual void          begin(uint16_t ID);
+
+    virtual const char*   isType();
+};
+#endif
+
+/*============================================================================
+ *  D I S P L A Y  L I S T
+ *===========================================================================*/
+#ifndef DISPLAY_LIST_SIZE
+#define DISPLAY_LIST_SIZE   32        // Maximum number of recorded commands per flush
+#endif
+#ifndef DISPLAY_LIST_TEXT
+#define DISPLAY_LIST_TEXT   128       // Size of the arena holding the recorded text
+#endif
+
+#define DL_NONE             0         // Dropped command
+#define DL_FILL_RECT        1         // fillRect()
+#define DL_FILL_ROUND_RECT  2         // fillRoundRect()
+#define DL_FILL_SCREEN      3         // fillScreen()
+#define DL_TEXT             4         // print() continuing at the current cursor
+#define DL_TEXT_AT          5         // print() after a setCursor()
+
+struct DisplayCommand {
+  uint8_t   type;                     // The DL_... command type
+  uint8_t   size;                     // Text size
+  int16_t   x;                        // X coordinate or text cursor
+  int16_t   y;                        // Y coordinate or text cursor
+  uint16_t  width;                    // Width, or offset of the text in the arena
+  uint16_t  height;                   // Height, or length of the text
+  uint16_t  color;                    // Fill or text color
+  uint16_t  bgColor;                  // Text background color, equal to color if transparent
+  int16_t   radius;                   // Corner radius
+};
+
+class DisplayList : public Print {
+
+  private:
+    DisplayCommand commands[DISPLAY_LIST_SIZE]; // The recorded commands
+    char           text[DISPLAY_LIST_TEXT];     // The recorded text
+    uint8_t        count      = 0;    // Number of recorded commands
+    uint16_t       textUsed   = 0;    // Number of used bytes in the text arena
+    DisplayCommand* open      = nullptr; // The text command being printed into
+
+    Adafruit_GFX*  gfx        = nullptr; // Where the commands are flushed to
+    int16_t        startX     = 0;    // Text cursor X when recording started
+    int16_t        startY     = 0;    // Text cursor Y when recording started
+
+    bool      covers(DisplayCommand* c, DisplayCommand* d); // True if c paints over all of d
+    bool      overlaps(DisplayCommand* c, DisplayCommand* d); // True if c and d share pixels
+    bool      merge(DisplayCommand* c, DisplayCommand* d);  // Merge c into d if they form one rect
+    void      optimize();             // Drop overdraw and merge rectangles
+    void      replay();               // Send the commands to the display
+
+  public:
+    bool      recording      = false; // True between Screen.beginFrame() and Screen.endFrame()
+
+    int16_t   cursorX        = 0;     // Pending setCursor() X coordinate
+    int16_t   cursorY        = 0;     // Pending setCursor() Y coordinate
+    bool      cursorSet      = false; // True if setCursor() was called since the last text
+    uint8_t   textSize       = 1;     // The text size at record time
+    uint16_t  textColor      = 0xFFFF;// The text color at record time
+    uint16_t  textBgColor    = 0xFFFF;// The text background color at record time
+
+    uint16_t  frameRecorded  = 0;     // Commands recorded in the last frame
+    uint16_t  frameEmitted   = 0;     // Commands sent to the display in the last frame
+    uint32_t  recorded       = 0;     // Total number of commands recorded
+    uint32_t  emitted        = 0;     // Total number of commands sent to the display
+
+    void      begin(Adafruit_GFX* pGfx); // Start recording a frame
+    void      end();                  // Flush and stop recording
+    void      flush();                // Optimize and replay what was recorded so far
+
+    void      add(uint8_t  type,      // Record a fill command
+                  int16_t  pX,     int16_t  pY,
+                  uint16_t pWidth, uint16_t pHeight,
+                  uint16_t pColor, int16_t  pRadius);
+    void      state();                // Record a state change
+    void      beginText();            // Start recording printed text
+    void      endText();              // Finish recording printed text
+
+    virtual size_t write(uint8_t c);  // Print interface, appends to the text arena
+};
+
+/*============================================================================
+ *  T E X T  M E T R I C S
+ *===========================================================================*/
+#ifndef TEXT_METRICS_CACHE_SIZE
+#define TEXT_METRICS_CACHE_SIZE   8   // Number of text bounds remembered
+#endif
+
+#define CLASSIC_FONT_WIDTH        6   // Width of a built-in font character cell, incl. spacing
+#define CLASSIC_FONT_HEIGHT       8   // Height of a built-in font character cell, incl. spacing
+
+struct TextBounds {
+  uint32_t  hash;                     // Hash of the text
+  uint16_t  length;                   // Length of the text
+  uint8_t   size;                     // Text size
+  int16_t   x;                        // X position, as it affects wrapping
+  int16_t   dx;                       // Offset of the bounds relative to x
+  int16_t   dy;                       // Offset of the bounds relative to y
+  uint16_t  width;                    // Width of the bounds
+  uint16_t  height;                   // Height of the bounds
+};
+
+class TextMetrics {
+
+  private:
+    TextBounds cache[TEXT_METRICS_CACHE_SIZE]; // Most recently used first
+    uint8_t    count        = 0;      // Number of cached bounds
+
+  public:
+    bool       classicFont  = true;   // Set to false when Screen.tft uses a GFX font
+    uint32_t   calculated   = 0;      // Bounds calculated from the built-in font metrics
+    uint32_t   hits         = 0;      // Bounds found in the cache
+    uint32_t   misses       = 0;      // Bounds requested from the display driver
+
+    void       bounds(Adafruit_GFX* gfx, uint8_t size,   // Bounds of a text
+                      const char* s, int16_t x, int16_t y,
+                      int16_t* xr, int16_t* yr,
+                      uint16_t* width, uint16_t* height);
+    void       clear();               // Forget all cached bounds, e.g. after a font change
+};
+
+/*============================================================================
+ *  L A T E N C Y  M O N I T O R
+ *===========================================================================*/
+#define LATENCY_BUCKETS      24       // Log2 buckets of microseconds, the last one collects the rest
+#define LATENCY_EVENT_TYPES  18       // Event codes below this get their own histogram
+#ifndef LATENCY_WIDGETS
+#define LATENCY_WIDGETS       8       // Number of widgets that get their own histogram
+#endif
+
+struct LatencyHistogram {
+  uint32_t  count;                    // Number of measured latencies
+  uint32_t  min;                      // Shortest latency in microseconds
+  uint32_t  max;                      // Longest latency in microseconds
+  uint64_t  total;                    // Sum of all latencies in microseconds
+  uint16_t  buckets[LATENCY_BUCKETS]; // Bucket b counts the latencies from 2^b up to 2^(b+1)
+
+  void      add(uint32_t latency);    // Count a latency
+  uint32_t  average();                // Average latency
+  uint32_t  percentile(uint8_t pct);  // Upper bound of the latency pct% of the events stay below
+  void      print(Print* out);        // Print count, min, avg, p99 and max on a single line
+};
+
+class LatencyMonitor {
+
+  private:
+    LatencyHistogram* events  = nullptr; // Per event code its histogram
+    LatencyHistogram* widgets = nullptr; // Per widget its histogram
+    Widget**  widgetIds       = nullptr; // The widgets the histograms belong to
+    uint8_t   widgetCount     = 0;    // Number of widgets with a histogram
+    uint8_t   depth           = 0;    // Nesting depth of dispatches
+
+    uint32_t  stamp           = 0;    // Raw sample time of the event being dispatched
+    uint16_t  event           = 0;    // Code of the event being dispatched
+    Widget*   widget          = nullptr; // Source of the event being dispatched
+    uint32_t  drawsAtStart    = 0;    // Draws completed when its dispatch started
+
+    bool      pending         = false; // An event waits for the repaint to draw it
+    uint32_t  pendingStamp    = 0;
+    uint16_t  pendingEvent    = 0;
+    Widget*   pendingWidget   = nullptr;
+    uint32_t  drawsAtPending  = 0;
+
+    void      record(uint16_t pEvent, Widget* pWidget, uint32_t latency);
+
+  public:
+    uint32_t  lastDraw        = 0;    // micros() at which the last draw primitive completed
+    uint32_t  draws           = 0;    // Number of completed draw primitives
+
+    bool      begin();                // Start measuring, allocates the histograms
+    void      end();                  // Stop measuring and free the histograms
+    bool      isEnabled();            // True if latencies are measured
+    void      clear();                // Forget all measured latencies
+
+    void      dispatchStarted(TouchEvent* e); // An event is about to be dispatched
+    void      dispatchFinished();     // Its dispatch has finished
+    void      drawn();                // A draw primitive has completed
+    void      frameFinished();        // The repaint at the end of the frame has finished
+
+    LatencyHistogram* eventHistogram(uint16_t pEvent);  // Histogram of an event code, or nullptr
+    LatencyHistogram* widgetHistogram(Widget* pWidget); // Histogram of a widget, or nullptr
+
+    void      print(Print* out);      // Report all histograms, e.g. on Serial
+};
+
 /*============================================================================
  *  S C R E E N
  *===========================================================================*/
+#define SCREEN_DAMAGE_SIZE  8         // Maximum number of separate damaged regions
+
+class Calibrator;
+
 class ScreenHandler : public Widget {
 
   private:
 	uint32_t  lastDispatch = 0;
-    TouchEventLink* laterQueue;       // Event that need to be dispatched later.
-    TouchEventLink* laterQueueLast;   // The last event in the queue.
+
+    Region    damage[SCREEN_DAMAGE_SIZE]; // Regions to repaint at the next frame
+    uint8_t   damageCount    = 0;     // The number of damaged regions
 
   Widget* dispatchOnly(TouchEvent* event);
 
+  bool    isDamaged(Widget* w);             // True if the widget intersects the damage
+  void    mergeDamage(uint8_t index);       // Merge a damaged region with overlapping ones
+
+  uint16_t* xCalibrationBuffer = nullptr;  // Calibration data used by Touch
+  uint16_t* yCalibrationBuffer = nullptr;
+  uint8_t   recalibrationRotation = 0;       // Rotation to restore after recalibrate()
+
+  static void recalibrated(Calibrator* calibrator); // Completion of recalibrate()
+
+  bool    beginAsk       = false;           // beginFull() asks for a recalibration tap
+  void    (*beginReady)() = nullptr;        // Called when beginFullAsync() has finished
+
+  void    splashAndCalibrate();             // beginFull() after the TFT is initialized
+  bool    beginSplash();                    // First part of beginFull(), up to the tap
+  void    completeBegin(bool recalibrate);  // Last part of beginFull(), after the tap
+  static void beginTapped(bool tapped);     // Completion of the tap wait of beginFullAsync()
+
+  Print*  printer();                        // Where print() output goes
+  size_t  printed(size_t n);                // Finish print() output
+
   public:
 
-    MCUFRIEND_kbv* tft;
+    DisplayDriver* driver;            // The display driver
+    Adafruit_GFX*  tft;               // Its GFX object, used for all the drawing
+
+    TouchEventQueue laterQueue;       // Events that need to be dispatched later.
+    DisplayList     displayList;      // Drawing recorded between beginFrame() and endFrame()
+    TextMetrics     textMetrics;      // Cached and calculated text bounds
+    WidgetIndex     index;            // Optional spatial index used by match()
+    LatencyMonitor  latency;          // Optional touch to display latency measurement
 
-    ScreenHandler(MCUFRIEND_kbv* pTft);
+    ScreenHandler(DisplayDriver* pDriver);
 
             void    begin();                           // Bare bones TFT begin
             void    beginFull();                       // Productized TFT begin
+            void    beginFullAsync(void (*ready)());   // Same, but does not block while waiting for a tap
+            bool    beginFast(bool longPress = false); // TFT begin with the persisted calibration only
+            void    recalibrate();                     // Calibrate the touch panel again, without blocking
+            bool    recalibrateOnLongPress = false;    // A long press on the background recalibrates
+            bool    recalibrateOnDrift = false;        // A DRIFT event recalibrates
+            bool    calibrateMesh = false;             // Calibrations also measure the 2D mesh
+            uint8_t calibrationPoints = 0;             // 3 or 5: calibrate affine with that many points
             void    analyzeEEPROM();                   // Analyze EEPROM memory
             Widget* dispatch(TouchEvent* event);       // Dispatches pending later events and then offered event
             void    dispatchLater(TouchEvent* event);  // Dispatches pending later events and then offered event
@@ -479,13 +896,23 @@ class ScreenHandler : public Widget {
             void    drawInverted();
             void    drawSibling(Widget* child);
 
+            void    addDamage(int16_t  pX,     int16_t  pY,      // Mark a screen region for repainting
+                              uint16_t pWidth, uint16_t pHeight);
+            bool    hasDamage();                       // True if there is a pending repaint
+            void    repaint();                         // Repaint only the damaged screen regions
+
+            void    beginFrame();                      // Record the drawing from here on
+            void    endFrame();                        // Optimize the recorded drawing and send it
+
     virtual void    onTouch(TouchEvent* event);
     virtual void    onUntouch(TouchEvent* event);
     virtual void    onDraw(TouchEvent* event);
     virtual void    onGotoSleep(TouchEvent* event);
     virtual void    onWakeUp(TouchEvent* event);
+    virtual void    onLongPress(TouchEvent* event);
+    virtual void    onDrift(TouchEvent* event);
 
-//    Widget* match(int16_t x, int16_t y);
+    virtual Widget* match(int16_t x, int16_t y);
     virtual const char*   isType();
 
     void clear(uint16_t fgColor, uint16_t bgColor);    // Clears the screen with an edge
@@ -556,7 +983,7 @@ class ScreenHandler : public Widget {
     void    setTextSize(int16_t s);
     void    setCursor(int16_t x, int16_t y);
 
-    void    getTextBounds(char* s,
+    void    getTextBounds(const char* s,
                   int16_t x, int16_t y,
                   int16_t *xr, int16_t *yr,
                   uint16_t *width, uint16_t *height);
@@ -567,13 +994,220 @@ class ScreenHandler : public Widget {
                   uint16_t *width, uint16_t *height);
 
     void    setTextColor(uint16_t strokeColor);
+    void    setTextColor(uint16_t color, uint16_t bgColor); // Text with an opaque background
 };
 
 extern ScreenHandler Screen;
 
+/*============================================================================
+ *  N O R M A L I Z E  T A B L E
+ *===========================================================================*/
+#define NORMALIZE_BUCKETS  64         // Maximum number of raw value buckets per axis
+
+struct NormalizeTable {
+  uint32_t* slope   = nullptr;        // Per marker segment the pixels per raw unit in Q16
+  uint8_t*  bucket  = nullptr;        // Per bucket of raw values its first marker segment
+  uint8_t   shift   = 0;              // Log2 of the raw value width of a bucket
+  uint16_t  limit   = 0;              // Raw values from here on map to the highest pixel
+};
+
+/*============================================================================
+ *  A F F I N E  C A L I B R A T I O N
+ *===========================================================================*/
+struct AffineCalibration {
+  int32_t xx, xy, x0;                 // Normalized x = (xx * raw x + xy * raw y + x0) >> 16
+  int32_t yx, yy, y0;                 // Normalized y = (yx * raw x + yy * raw y + y0) >> 16
+  int16_t width;                      // The extent of the normalized coordinates
+  int16_t height;
+};
+
+/*============================================================================
+ *  T O U C H  M E S H
+ *===========================================================================*/
+#ifndef TOUCH_MESH_COLS
+#define TOUCH_MESH_COLS    5          // Mesh nodes per row, including both screen edges
+#endif
+#ifndef TOUCH_MESH_ROWS
+#define TOUCH_MESH_ROWS    7          // Mesh nodes per column, including both screen edges
+#endif
+#define TOUCH_MESH_NODES   (TOUCH_MESH_COLS * TOUCH_MESH_ROWS)
+#define TOUCH_MESH_CELLS   ((TOUCH_MESH_COLS - 1) * (TOUCH_MESH_ROWS - 1))
+
+struct MeshCell {
+  int16_t x[4];                       // Bilinear coefficients a, b, c, d of the X correction
+  int16_t y[4];                       // Same for the Y correction
+};
+
+class TouchMesh {
+
+  private:
+    MeshCell* cells    = nullptr;     // Coefficient cache, one per mesh cell
+    uint32_t  colScale = 0;           // Mesh columns per pixel in Q16
+    uint32_t  rowScale = 0;           // Mesh rows per pixel in Q16
+    int16_t   width    = 0;           // The extent of the normalized coordinates
+    int16_t   height   = 0;
+
+  public:
+    bool      build(int16_t pWidth,   // Build the cache from the corrections of the nodes
+                    int16_t pHeight,
+                    const int8_t* corrections);
+    void      clear();                // No correction anymore
+    bool      isEnabled();            // True if a mesh is built
+    void      apply(XY* touch);       // Correct normalized coordinates
+};
+
+/*============================================================================
+ *  T O U C H  D R I F T
+ *===========================================================================*/
+#define TOUCH_DRIFT_SHIFT           4     // Each touch counts for 1/2^shift in the bias
+#define TOUCH_DRIFT_THRESHOLD       6     // Pixels of bias at which the drift is detected
+#define TOUCH_DRIFT_MIN_SAMPLES    16     // Button touches needed before drift is detected
+#define TOUCH_DRIFT_MAX_CORRECTION 12     // Pixels autoCorrect may correct, more raises DRIFT
+#define TOUCH_DRIFT_MISS_MARGIN    15     // Pixels a near miss may be off a button
+#define TOUCH_DRIFT_RETRY_TIME   1500     // ms in which a touch on a button makes a miss a near miss
+
+class TouchDrift {
+
+  private:
+    int16_t       touchX         = 0;     // The touch in progress
+    int16_t       touchY         = 0;
+    unsigned long touchTime      = 0;
+    bool          touchHit       = true;  // It hit a button
+    int16_t       missX          = 0;     // The last touch that hit no button
+    int16_t       missY          = 0;
+    unsigned long missTime       = 0;
+    bool          missed         = false;
+
+    void          add(int16_t dx,         // Add the offset of a touch from a button center
+                      int16_t dy);
+
+  public:
+    bool          enabled        = false; // Estimate the drift from the touches on buttons
+    bool          autoCorrect    = false; // Correct a small drift instead of raising DRIFT
+    uint8_t       threshold      = TOUCH_DRIFT_THRESHOLD;
+    uint8_t       minSamples     = TOUCH_DRIFT_MIN_SAMPLES;
+    uint8_t       maxCorrection  = TOUCH_DRIFT_MAX_CORRECTION;
+    uint8_t       missMargin     = TOUCH_DRIFT_MISS_MARGIN;
+    uint16_t      retryTime      = TOUCH_DRIFT_RETRY_TIME;
+
+    int16_t       biasX          = 0;     // Mean offset of the touches from the button centers,
+    int16_t       biasY          = 0;     // in screen pixels with 4 fraction bits
+    uint16_t      samples        = 0;     // Offsets in the bias
+    bool          detected       = false; // The bias exceeds the threshold
+    uint16_t      detections     = 0;     // Times the drift was detected
+    int16_t       correctionX    = 0;     // Added to the normalized coordinates by getTouch()
+    int16_t       correctionY    = 0;
+
+    void          touch(int16_t x,        // A touch starts, called by the TouchHandler
+                        int16_t y,
+                        unsigned long now);
+    void          hit(Widget* button);    // The touch hit a button, called by the ButtonWidget
+    void          forget();               // Forget the bias, e.g. after a correction
+    void          reset();                // Also drop the correction, e.g. after a calibration
+};
+
+/*============================================================================
+ *  T O U C H  F I L T E R
+ *===========================================================================*/
+#define TOUCH_FILTER_WINDOW   5       // Maximum number of samples of the median filter
+#define XY_DELTA_THRESHOLD    5       // Default dead band: ignore moves less or equal to this
+#define TOUCH_MIN_INTERVAL  100       // Default ms between two digested samples
+#define TOUCH_BRIDGE_TIME    15       // Default ms a dip in the pressure is bridged
+
+class TouchFilter {
+
+  private:
+    int16_t   xs[TOUCH_FILTER_WINDOW]; // The last pressed raw X coordinates
+    int16_t   ys[TOUCH_FILTER_WINDOW]; // The last pressed raw Y coordinates
+    uint8_t   count        = 0;       // Number of samples in the window
+    uint8_t   head         = 0;       // Where the next sample goes
+    int32_t   iirX         = 0;       // Smoothed X coordinate, 4 fraction bits
+    int32_t   iirY         = 0;       // Smoothed Y coordinate, 4 fraction bits
+    bool      smoothing    = false;   // iirX and iirY hold the touch in progress
+    bool      wasPressed   = false;   // The last sample was pressed
+    bool      releasing    = false;   // A dip is being bridged
+    uint32_t  releaseStamp = 0;       // micros() at which the dip started
+    XY        last;                   // The last filtered pressed sample
+
+    int16_t   median(int16_t* values); // Median of the window
+
+  public:
+    //
+    //  Stages of getRawTouchData(), in the order they are applied.
+    //
+    int16_t   minPressure  = 0;       // Pressure gate: lower pressures are not pressed
+    int16_t   maxPressure  = 32767;   // Pressure gate: higher pressures are not pressed
+    uint16_t  bridgeTime   = TOUCH_BRIDGE_TIME; // Dips up to this many ms stay pressed, 0 is off
+    uint8_t   medianSize   = 1;       // Median of this many samples, 1 is off
+    uint8_t   iirShift     = 0;       // Smoothing, each sample counts for 1/2^iirShift, 0 is off
+
+    //
+    //  Stages of TouchHandler::digest(), on screen coordinates.
+    //
+    uint16_t  deadBand     = XY_DELTA_THRESHOLD; // Moves up to this many pixels are ignored
+    uint16_t  minInterval  = TOUCH_MIN_INTERVAL; // ms that must pass between digested samples
+
+    bool      apply(XY* sample, bool pressed); // Filter a raw sample, returns if pressed
+    void      reset();                         // Forget the samples of the touch in progress
+};
+
+/*============================================================================
+ *  G E S T U R E  R E C O G N I Z E R
+ *===========================================================================*/
+#define GESTURE_LONG_PRESS_TIME      600  // ms a touch must last to be a long press
+#define GESTURE_TAP_TIME             250  // ms a touch may last to be a tap
+#define GESTURE_DOUBLE_TAP_INTERVAL  350  // ms between the two taps of a double tap
+#define GESTURE_DOUBLE_TAP_DISTANCE   20  // Pixels the two taps of a double tap may be apart
+#define GESTURE_DRAG_DISTANCE         10  // Pixels a touch must move to become a drag
+#define GESTURE_SWIPE_DISTANCE        40  // Pixels a swipe must cover
+#define GESTURE_SWIPE_VELOCITY       300  // Pixels per second a swipe must have when lifted
+
+class GestureRecognizer {
+
+  private:
+    uint8_t       state          = 0;   // Idle, pressed or dragging
+    bool          longPressed    = false; // The long press of this touch has been signaled
+    unsigned long downTime       = 0;   // When the touch started
+    unsigned long lastTime       = 0;   // When the last sample was taken
+    int16_t       lastX          = 0;   // Position of the last pressed sample
+    int16_t       lastY          = 0;
+    unsigned long tapTime        = 0;   // When the last tap ended, 0 if none
+    int16_t       tapX           = 0;   // Position of the last tap
+    int16_t       tapY           = 0;
+
+  public:
+    bool          enabled        = false; // Recognize gestures in digest()
+
+    uint16_t      longPressTime     = GESTURE_LONG_PRESS_TIME;
+    uint16_t      maxTapTime        = GESTURE_TAP_TIME;
+    uint16_t      doubleTapInterval = GESTURE_DOUBLE_TAP_INTERVAL;
+    uint16_t      doubleTapDistance = GESTURE_DOUBLE_TAP_DISTANCE;
+    uint16_t      dragDistance      = GESTURE_DRAG_DISTANCE;
+    uint16_t      swipeDistance     = GESTURE_SWIPE_DISTANCE;
+    uint16_t      swipeVelocity     = GESTURE_SWIPE_VELOCITY;
+
+    int16_t       startX         = 0;   // Where the touch started
+    int16_t       startY         = 0;
+    int16_t       x              = 0;   // Position of the recognized gesture
+    int16_t       y              = 0;
+    int16_t       vx             = 0;   // Smoothed velocity in pixels per second
+    int16_t       vy             = 0;
+    Widget*       target         = nullptr; // The widget the touch started on
+    bool          matched        = false;   // True once target is known for this touch
+
+    uint16_t      sample(bool pressed,      // Feed a sample, returns a gesture event code or NONE
+                         int16_t pX, int16_t pY,
+                         unsigned long now);
+    void          reset();                  // Forget the touch in progress
+};
+
 /*============================================================================
  *  T O U C H  H A N D L E R
  *===========================================================================*/
+#define TOUCH_POLL_ACTIVE     0       // Touched or recently active, polled fast
+#define TOUCH_POLL_IDLE       1       // Not touched for a while, polled slower and slower
+#define TOUCH_POLL_SLEEP      2       // The screen sleeps, only checked for a wake up touch
+#define TOUCH_POLL_MODES      3
 class TouchHandler : public Task {
     //=============================================================================================
 
@@ -595,6 +1229,7 @@ class TouchHandler : public Task {
     int16_t        x                 = 0;		// The X coordinate of the current event
     int16_t        y                 = 0;		// The Y coordinate of the current event
     Widget*        source            = nullptr;	// The Y coordinate of the current event
+    uint32_t       sampleStamp       = 0;          // micros() of the raw sample being digested
 
     bool           lastPressed       = false;      // Whether the panel was pressed with the last event.
     int16_t        lastEvent         = 0;          // The last event type
@@ -607,6 +1242,37 @@ class TouchHandler : public Task {
 
     void saveState();				// Save the Touch panel its state in terms of generated Touch events
 
+    unsigned long currentTime();                   // millis(), or the time of the clock hook
+
+    //----------------------------------------------------------------------------------------------
+    //  The DRAW event kept in drag mode
+    //----------------------------------------------------------------------------------------------
+    bool           pendingDraw       = false;      // A DRAW event waits for flushDraw()
+    unsigned long  pendingTimestamp  = 0;
+    int16_t        pendingX          = 0;
+    int16_t        pendingY          = 0;
+    Widget*        pendingSource     = nullptr;
+    uint32_t       pendingStamp      = 0;
+    unsigned long  lastDrawTime      = 0;          // When the last kept DRAW event was dispatched
+
+    //----------------------------------------------------------------------------------------------
+    //  Adaptive polling
+    //----------------------------------------------------------------------------------------------
+    unsigned long  lastPoll          = 0;          // When the touch panel was polled last
+    unsigned long  lastActivity      = 0;          // When the touch panel was touched last
+    unsigned long  lastModeUpdate    = 0;          // When the time per poll mode was accounted last
+
+    void           updatePollMode(unsigned long now); // Choose the poll mode and interval
+    void           checkDrift(unsigned long now);  // Correct the detected drift or raise DRIFT
+
+    void dispatch(uint16_t      pEvent,     // Create a pooled event and dispatch it
+                  unsigned long timeStamp,
+                  int16_t       pX,
+                  int16_t       pY,
+                  EventSource*  pSource,
+                  int16_t       pVx = 0,
+                  int16_t       pVy = 0);
+
     //----------------------------------------------------------------------------------------------
     //  Data and methods needed for the conversion from raw to screen coordinates
     //----------------------------------------------------------------------------------------------
@@ -620,11 +1286,28 @@ class TouchHandler : public Task {
     float          rawAvgXMarkerDistance;          // The average X marker distance in raw coordinates
     float          rawAvgYMarkerDistance;          // The average Y marker distance in raw coordinates
 
+    NormalizeTable xTable;                         // Lookup table for normalizing X coordinates
+    NormalizeTable yTable;                         // Lookup table for normalizing Y coordinates
+
+    AffineCalibration affine;                      // Used instead of the axes, if useAffine
+    bool           useAffine         = false;
+
+    int16_t        xFlip             = 0;          // Rotation transform of getTouch(), see setRotation()
+    int16_t        xOffset           = 0;
+    int16_t        yFlip             = 0;
+    int16_t        yOffset           = 0;
+
     uint16_t normalize(uint16_t  raw,              // Normalize a single coordinate X or Y. 
                        uint16_t* data, 
                        uint16_t  size, 
                        float     avgRawCellSize);
-    void     normalize(XY*       touch);           // Normalize the raw X and Y coordinates
+    uint16_t normalize(uint16_t  raw,              // Normalize a single coordinate using its lookup table
+                       uint16_t* data,
+                       uint16_t  size,
+                       NormalizeTable* table);
+    void     buildTable(NormalizeTable* table,     // (Re)build the lookup table of an axis
+                        uint16_t* data,
+                        uint16_t  size);
 
     
     //==============================================================================================
@@ -632,6 +1315,30 @@ class TouchHandler : public Task {
     public:
 
     uint32_t  inactivityTimeout  = 300000;         // Inactivity interval after which it is signaled
+    unsigned long (*clock)()     = nullptr;        // Replaces millis(), e.g. during a fast replay
+    void (*rawSampleSink)(XY* raw,                 // If set, gets the raw samples instead of the widgets,
+                          bool pressed,            // e.g. during a calibration
+                          unsigned long now) = nullptr;
+    GestureRecognizer gestures;                    // Long press, double tap, swipe and drag
+    TouchFilter    filter;                         // Filter pipeline of the raw samples
+    TouchMesh      mesh;                           // Optional 2D correction of the normalized coordinates
+    TouchDrift     drift;                          // Optional drift detection from the button touches
+
+    bool           dragMode          = false;      // Digest every sample while touched, one DRAW per frame
+    uint16_t       drawInterval      = 40;         // Minimum ms between two DRAW events in drag mode
+    uint32_t       samplesTaken      = 0;          // Samples read by digest()
+    uint32_t       eventsDispatched  = 0;          // Events dispatched by digest()
+    uint32_t       drawsCoalesced    = 0;          // DRAW events replaced by a later one in drag mode
+
+    bool           adaptivePolling   = false;      // Poll slower when idle or asleep
+    uint16_t       activeInterval    = 10;         // ms between polls when active
+    uint16_t       idleInterval      = 100;        // Maximum ms between polls when idle
+    uint16_t       sleepInterval     = 250;        // ms between polls while the screen sleeps
+    uint16_t       activeHold        = 2000;       // ms without touches before becoming idle
+    uint16_t       idleStep          = 1000;       // ms after which the idle interval doubles
+    uint8_t        pollMode          = TOUCH_POLL_ACTIVE; // The current poll mode
+    uint16_t       pollInterval      = 10;         // The current ms between polls
+    uint32_t       timeInMode[TOUCH_POLL_MODES] = {0, 0, 0}; // ms spent in each poll mode
 
     //==============================================================================================
 
@@ -649,10 +1356,16 @@ class TouchHandler : public Task {
     //  Touch detection
     //----------------------------------------------------------------------------------------------
     bool            digest();	                   // Translate touches into TouchEvents and dispatch them.
+    void            flushDraw();                   // Dispatch the DRAW event kept in drag mode
 
     bool            getTouch(XY* touchData);       // Returns touch position in screen coordinates
 
     bool            tapOrTimeout(long timeout);    // If tapped it returns true
+    bool            tapOrTimeout(long timeout,     // Same, but calls back instead of blocking
+                                 void (*done)(bool tapped));
+
+    bool            fastNormalize    = true;       // Use the lookup tables instead of the float calculation
+    void            normalize(XY* touch);          // Normalize the raw X and Y coordinates
 
     //----------------------------------------------------------------------------------------------
     //  Data for the coordinate conversion from raw to screen methods
@@ -665,6 +1378,11 @@ class TouchHandler : public Task {
                           uint16_t* markers);
     void            setMarkerDistance(             // Assign the pixel distance between two markers, equal in X an Y
                           uint16_t pixels);
+    void            setAffineCalibration(          // Use an affine calibration instead of the axes, nullptr stops it
+                          AffineCalibration* pAffine);
+    bool            isAffine();                    // True if the affine calibration is used
+    void            setRotation(                   // Build the rotation transform of getTouch()
+                          uint8_t pRotation);
  
     //----------------------------------------------------------------------------------------------
     //  Getters for data attributes
@@ -678,4 +1396,94 @@ class TouchHandler : public Task {
 
 extern TouchHandler Touch;
 
+/*============================================================================
+ *  T A P  W A I T E R
+ *===========================================================================*/
+class TapWaiter : public Task {
+
+  private:
+    uint8_t       state      = 0;        // Idle, waiting for the touch or for its release
+    unsigned long started    = 0;        // When the wait started
+    unsigned long timeout    = 0;        // ms to wait for the tap, 0 is forever
+    uint16_t      counter    = 0;        // Seconds counted down so far
+    bool          countDown  = false;    // Print the seconds waited on the screen
+    void          (*done)(bool tapped) = nullptr; // Called when the wait is over
+
+    void          finish(bool pTapped);
+    void          release();             // Give the Touch samples back
+    void          sample(bool pressed);  // Advance the wait with a sample
+
+    static void   forward(XY* raw, bool pressed, unsigned long now); // Touch samples while waiting
+
+  public:
+    bool          tapped     = false;    // Result of the last wait
+
+                  TapWaiter();
+
+    virtual void  exec();                // Advance the wait, without blocking
+
+    bool          start(unsigned long pTimeout,   // Wait for a tap, returns false if already waiting
+                        void (*pDone)(bool tapped),
+                        bool pCountDown = false);
+    void          cancel();              // Stop waiting, without calling back
+    bool          isWaiting();           // True until the tap or the timeout
+};
+
+extern TapWaiter TapWait;
+
+/*============================================================================
+ *  T O U C H  R E C O R D E R
+ *===========================================================================*/
+#define TOUCH_LOG_VERSION   1         // Version of the binary touch log format
+
+#define TOUCH_LOG_RELEASED  0x01      // Record tag: a sample while not pressed
+#define TOUCH_LOG_PRESSED   0x02      // Record tag: a sample while pressed
+#define TOUCH_LOG_EVENT     0x03      // Record tag: a dispatched TouchEvent
+
+class TouchRecorder {
+
+  private:
+    Print*    out            = nullptr;  // Where the log is recorded to
+    Stream*   in             = nullptr;  // Where the log is replayed from
+    bool      realtime       = false;    // Replay at the recorded pace
+    bool      (*source)(XY*) = nullptr;  // The raw touch source before recording started
+
+    uint32_t  lastStamp      = 0;        // micros() of the last recorded record
+    uint32_t  logTime        = 0;        // Log time of the last replayed record, in microseconds
+    uint32_t  startMicros    = 0;        // micros() at which the replay started
+    uint32_t  startMillis    = 0;        // millis() at which the replay started
+    XY        sample;                    // The last replayed sample
+    bool      pressed        = false;    // Whether the last replayed sample was pressed
+    bool      due            = false;    // The next sample has been read but is not due yet
+    XY        next;                      // The sample read ahead
+    bool      nextPressed    = false;
+
+    void      writeVarint(uint32_t value);
+    void      writeInt16(int16_t value);
+    bool      readVarint(uint32_t* value);
+    bool      readInt16(int16_t* value);
+    bool      readSample(XY* data, bool* isPressed); // Read the next sample, skipping events
+    void      finish();                  // Stop replaying, restore the touch source and clock
+
+    static bool          recordSample(XY* data);     // rawTouchSource while recording
+    static bool          replaySample(XY* data);     // rawTouchSource while replaying
+    static unsigned long replayClock();              // Touch.clock during a fast replay
+
+  public:
+    uint32_t  samples        = 0;        // Samples recorded or replayed
+    uint32_t  events         = 0;        // Events recorded or replayed
+    uint32_t  mismatches     = 0;        // Replayed events that differ from the recorded ones
+
+    bool      record(Print* pOut);       // Start recording raw samples and events
+    bool      replay(Stream* pIn,        // Replay a log in place of the touch panel
+                     bool pRealtime);
+    void      stop();                    // Stop recording or replaying
+    bool      isRecording();
+    bool      isReplaying();
+
+    void      event(TouchEvent* e);      // Record or check a dispatched event
+};
+
+extern TouchRecorder TouchLog;
+
 #endif
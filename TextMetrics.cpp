@@ -0,0 +1,157 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TextMetrics.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+/*==============================================================================
+ *
+ *  Text bounds without asking the display driver every time.
+ *
+ *  With the built-in 5x7 font every character occupies a cell of 6 by 8
+ *  pixels times the text size. As long as a text has a single line and does
+ *  not wrap at the right edge of the screen, its bounds follow from its
+ *  length; this is what Adafruit_GFX::getTextBounds() calculates as well.
+ *
+ *  Other texts, or all texts when a GFX font is used, are measured by the
+ *  driver. The results are kept in a small cache, most recently used first,
+ *  keyed by the hash and length of the text, its size and x position.
+ *
+ *============================================================================*/
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the bounds of a text as Adafruit_GFX::getTextBounds() would.
+ *
+ *  gfx          The GFX object to measure with if needed
+ *  size         The text size
+ *  s            The text
+ *  x            X position of the cursor
+ *  y            Y position of the cursor
+ *  xr           Receives the x coordinate of the bounds
+ *  yr           Receives the y coordinate of the bounds
+ *  width        Receives the width of the bounds
+ *  height       Receives the height of the bounds
+ *
+ *---------------------------------------------------------------------------*/
+void TextMetrics::bounds(Adafruit_GFX* gfx, uint8_t size,
+		                 const char* s, int16_t x, int16_t y,
+		                 int16_t* xr, int16_t* yr,
+		                 uint16_t* width, uint16_t* height) {
+
+  if (size == 0)              // Like Adafruit_GFX::setTextSize()
+	size = 1;
+
+  //
+  //  Hash (FNV-1a) and measure the text in one go
+  //
+  uint32_t hash      = 2166136261UL;
+  uint16_t length    = 0;
+  bool     multiLine = false;
+
+  for (const char* p = s; *p; p++) {
+	hash = (hash ^ (uint8_t)*p) * 16777619UL;
+	if (*p == '\n' || *p == '\r')
+	  multiLine = true;
+	length++;
+  }
+
+  //
+  //  Built-in font on a single line that does not wrap: arithmetic
+  //
+  uint16_t cells = length * CLASSIC_FONT_WIDTH * size;
+  if (classicFont && ! multiLine && x + (int32_t)cells <= gfx->width()) {
+	calculated++;
+	*xr     = x;
+	*yr     = y;
+	*width  = cells;
+	*height = length ? CLASSIC_FONT_HEIGHT * size : 0;
+	return;
+  }
+
+  //
+  //  Look it up in the cache, moving a hit to the front
+  //
+  for (uint8_t i = 0; i < count; i++) {
+	TextBounds* b = &cache[i];
+	if (b->hash == hash && b->length == length && b->size == size && b->x == x) {
+	  TextBounds hit = *b;
+	  memmove(&cache[1], &cache[0], i * sizeof(TextBounds));
+	  cache[0] = hit;
+
+	  hits++;
+	  *xr     = x + hit.dx;
+	  *yr     = y + hit.dy;
+	  *width  = hit.width;
+	  *height = hit.height;
+	  return;
+	}
+  }
+
+  //
+  //  Ask the driver and remember the result, dropping the least recently used
+  //
+  misses++;
+  gfx->getTextBounds(s, x, y, xr, yr, width, height);
+
+  if (count < TEXT_METRICS_CACHE_SIZE)
+	count++;
+  memmove(&cache[1], &cache[0], (count - 1) * sizeof(TextBounds));
+
+  TextBounds* b = &cache[0];
+  b->hash   = hash;
+  b->length = length;
+  b->size   = size;
+  b->x      = x;
+  b->dx     = *xr - x;
+  b->dy     = *yr - y;
+  b->width  = *width;
+  b->height = *height;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Forget all cached bounds. Call this after changing the font.
+ *
+ *---------------------------------------------------------------------------*/
+void TextMetrics::clear() {
+  count = 0;
+}
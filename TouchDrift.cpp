@@ -0,0 +1,179 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TouchDrift.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+/*==============================================================================
+ *
+ *  A panel drifts over time, and then the touches slowly move away from what
+ *  the user aims at. The drift is estimated from the normal use of the
+ *  buttons: users aim at the center of a button, so on a calibrated panel
+ *  the touches scatter around it. The bias is a running mean of the offset
+ *  of the touches from the centers of the buttons they hit:
+ *
+ *    bias += (offset - bias) / 2^TOUCH_DRIFT_SHIFT
+ *
+ *  in fixed point with 4 fraction bits. A touch can only be off a button
+ *  center by half the button, so a large drift shows in the misses. A touch
+ *  that hit no button, shortly followed by one that does, was most likely
+ *  meant for that button. If it is at most missMargin pixels off the button,
+ *  its offset counts too.
+ *
+ *  All of this is a handful of integer operations per TOUCH event, the
+ *  TouchHandler then corrects the drift or raises a DRIFT event.
+ *
+ *============================================================================*/
+
+/*------------------------------------------------------------------------------
+ *
+ *  A touch starts. If the previous touch hit no button, it is remembered as
+ *  a possible near miss.
+ *
+ *  x, y       The screen coordinates of the touch
+ *  now        When it started in ms
+ *
+ *----------------------------------------------------------------------------*/
+void TouchDrift::touch(int16_t x, int16_t y, unsigned long now) {
+
+  if (!touchHit) {
+    missX    = touchX;
+    missY    = touchY;
+    missTime = touchTime;
+    missed   = true;
+  }
+
+  touchX    = x;
+  touchY    = y;
+  touchTime = now;
+  touchHit  = false;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  The touch in progress hit a button. Its offset from the button center is
+ *  added to the bias, and so is that of a near miss just before.
+ *
+ *  button     The button that was hit
+ *
+ *----------------------------------------------------------------------------*/
+void TouchDrift::hit(Widget* button) {
+
+  if (!enabled || touchHit)
+    return;
+
+  touchHit = true;
+
+  int16_t halfWidth  = button->width  >> 1;
+  int16_t halfHeight = button->height >> 1;
+
+  if (missed && touchTime - missTime <= retryTime) {
+    int16_t dx = missX - button->centerX;
+    int16_t dy = missY - button->centerY;
+
+    if (abs(dx) <= halfWidth  + missMargin &&
+        abs(dy) <= halfHeight + missMargin)
+      add(dx, dy);
+  }
+
+  missed = false;
+
+  add(constrain(touchX - button->centerX, -halfWidth,  halfWidth),
+      constrain(touchY - button->centerY, -halfHeight, halfHeight));
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Adds the offset of a touch from a button center to the bias, and detects
+ *  drift once there are enough of them.
+ *
+ *  dx, dy     The offset in pixels
+ *
+ *----------------------------------------------------------------------------*/
+void TouchDrift::add(int16_t dx, int16_t dy) {
+
+  //
+  //  Until there are 2^shift samples the bias is their plain mean, else
+  //  the running mean would still lean towards zero when drift is checked
+  //
+  if (samples < (1 << TOUCH_DRIFT_SHIFT)) {
+    samples++;
+    biasX += ((dx << 4) - biasX) / (int16_t)samples;
+    biasY += ((dy << 4) - biasY) / (int16_t)samples;
+  }
+  else {
+    if (samples < 0xffff)
+      samples++;
+    biasX += ((dx << 4) - biasX) >> TOUCH_DRIFT_SHIFT;
+    biasY += ((dy << 4) - biasY) >> TOUCH_DRIFT_SHIFT;
+  }
+
+  if (samples >= minSamples &&
+      (abs(biasX) > (threshold << 4) || abs(biasY) > (threshold << 4)))
+    detected = true;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Forgets the bias, the correction stays.
+ *
+ *----------------------------------------------------------------------------*/
+void TouchDrift::forget() {
+
+  biasX    = 0;
+  biasY    = 0;
+  samples  = 0;
+  detected = false;
+  missed   = false;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Forgets the bias and drops the correction.
+ *
+ *----------------------------------------------------------------------------*/
+void TouchDrift::reset() {
+
+  forget();
+
+  correctionX = 0;
+  correctionY = 0;
+}
@@ -44,6 +44,19 @@
 
 #define DEBUG		0
 
+/**--------------------------------------------------------------------------------
+ *
+ *  Create an empty TouchEvent, e.g. as a slot in a queue or a pool.
+ *
+ *------------------------------------------------------------------------------*/
+TouchEvent::TouchEvent() {
+
+	next = nullptr;
+	prev = nullptr;
+
+	init(TouchEvents::NONE, 0, 0, 0, nullptr, false);
+}
+
 /**--------------------------------------------------------------------------------
  *
  *  Create a TouchEvent
@@ -119,6 +132,9 @@ void TouchEvent::init(
   x         = pX;		    // X coordinate
   y         = pY;		    // Y coordinate
   source    = pSource;		// Set the touched Widget, which is seen as the source of the event
+  rawStamp  = 0;		    // Set by the TouchHandler for events stemming from a touch sample
+  vx        = 0;		    // No velocity
+  vy        = 0;
 
   passOn    = pPassOn;		// Pass up to chain of parents
 
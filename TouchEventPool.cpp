@@ -0,0 +1,166 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TouchEventPool.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+static_assert(TOUCH_EVENT_POOL_SIZE <= 16,
+		      "TOUCH_EVENT_POOL_SIZE must not exceed 16");
+
+/*==============================================================================
+ *
+ *  A fixed pool of TouchEvents with acquire/release semantics.
+ *
+ *  The TouchHandler acquires the events it generates from this pool, instead
+ *  of creating them on the stack. A widget that wants to hold on to an event
+ *  beyond its on*() handler makes an owned copy with copy() and releases it
+ *  when done. The high water mark tells how many events are alive at the
+ *  same time on the busiest screens, which is what the pool must be sized to.
+ *
+ *============================================================================*/
+TouchEventPool::TouchEventPool() {
+  usedMask = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Acquire an event from the pool and initialize it.
+ *  Returns nullptr if the pool is exhausted.
+ *
+ *  pEvent       The event code
+ *  timeStamp    The time stamp of the event
+ *  pX           The x-coordinate of the event
+ *  pY           The y-coordinate of the event
+ *  source       The widget receiving the event
+ *
+ *---------------------------------------------------------------------------*/
+TouchEvent* TouchEventPool::acquire(uint16_t      pEvent,
+		                            unsigned long timeStamp,
+		                            int16_t       pX,
+		                            int16_t       pY,
+		                            EventSource*  source) {
+
+  for (uint8_t i = 0; i < TOUCH_EVENT_POOL_SIZE; i++) {
+
+	uint16_t bit = (uint16_t)1 << i;
+	if (usedMask & bit)
+	  continue;
+
+	usedMask |= bit;
+	acquired++;
+	if (++inUse > highWater) {
+	  highWater = inUse;
+	}
+
+	TouchEvent* e = &events[i];
+	e->next = nullptr;
+	e->prev = nullptr;
+	e->init(pEvent, timeStamp, pX, pY, source, false);
+
+	return e;
+  }
+
+  failures++;
+  return nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Acquire an owned copy of an event, e.g. before deferring it.
+ *  Returns nullptr if the pool is exhausted.
+ *
+ *  event        The event to copy
+ *
+ *---------------------------------------------------------------------------*/
+TouchEvent* TouchEventPool::copy(TouchEvent* event) {
+
+  TouchEvent* e = acquire(event->event, event->timestamp, event->x, event->y, event->source);
+  if (e) {
+	*e = *event;
+	e->next = nullptr;
+	e->prev = nullptr;
+  }
+
+  return e;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Return an event to the pool. Events not owned by the pool are ignored.
+ *
+ *  e            The event to release
+ *
+ *---------------------------------------------------------------------------*/
+void TouchEventPool::release(TouchEvent* e) {
+
+  if (!owns(e))
+	return;
+
+  uint16_t bit = (uint16_t)1 << (e - events);
+  if (usedMask & bit) {
+	usedMask &= ~bit;
+	inUse--;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if the event is one of the pooled events.
+ *
+ *  e            The event to check
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchEventPool::owns(TouchEvent* e) {
+  return e >= events && e < events + TOUCH_EVENT_POOL_SIZE;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Zero the counters. The high water mark restarts at the current usage.
+ *
+ *---------------------------------------------------------------------------*/
+void TouchEventPool::resetStatistics() {
+  acquired  = 0;
+  failures  = 0;
+  highWater = inUse;
+}
+
+TouchEventPool EventPool;	// The pool of TouchEvents
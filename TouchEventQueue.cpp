@@ -0,0 +1,181 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TouchEventQueue.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+static_assert((TOUCH_EVENT_QUEUE_SIZE & (TOUCH_EVENT_QUEUE_SIZE - 1)) == 0,
+		      "TOUCH_EVENT_QUEUE_SIZE must be a power of two");
+static_assert(TOUCH_EVENT_QUEUE_SIZE <= 128,
+		      "TOUCH_EVENT_QUEUE_SIZE must not exceed 128");
+
+#define QUEUE_MASK  (TOUCH_EVENT_QUEUE_SIZE - 1)
+
+//
+//  Keeps the compiler from moving memory accesses across this point.
+//  Needed to publish a slot only after it has been completely copied.
+//
+#define QUEUE_BARRIER()  __asm__ __volatile__("" ::: "memory")
+
+/*==============================================================================
+ *
+ *  A fixed capacity FIFO queue of TouchEvents, without any heap allocation.
+ *
+ *  Events are copied in and out by value. The head and tail are free running
+ *  8 bit indices, so the number of queued events is simply head - tail.
+ *  Only push() writes the head and only pop() writes the tail. This makes it
+ *  safe to push from an interrupt routine while popping from loop(), or the
+ *  other way around, as long as there is one producer and one consumer.
+ *
+ *  NOTE:
+ *  The QUEUE_DROP_OLDEST policy makes push() advance the tail as well.
+ *  Only use it if the producer and consumer run in the same context.
+ *
+ *============================================================================*/
+TouchEventQueue::TouchEventQueue() {
+  head = 0;
+  tail = 0;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Copy an event into the queue. Returns false if the event was refused,
+ *  because the queue is full and the drop policy is QUEUE_DROP_NEWEST.
+ *
+ *  event      The event to queue
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchEventQueue::push(TouchEvent* event) {
+
+  uint8_t h = head;
+
+  //
+  //  Handle a full queue according to the drop policy
+  //
+  if ((uint8_t)(h - tail) >= TOUCH_EVENT_QUEUE_SIZE) {
+
+	overflows++;
+	dropped++;
+
+	if (dropPolicy == QUEUE_DROP_NEWEST) {
+	  return false;
+	}
+
+	tail = tail + 1;    // Discard the oldest event
+  }
+
+  //
+  //  Copy the event and only then publish it to the consumer
+  //
+  events[h & QUEUE_MASK] = *event;
+  QUEUE_BARRIER();
+  head = h + 1;
+
+  uint8_t n = (uint8_t)(head - tail);
+  if (n > highWater) {
+	highWater = n;
+  }
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Copy the oldest event out of the queue. Returns false if it is empty.
+ *
+ *  event      Receives the oldest event
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchEventQueue::pop(TouchEvent* event) {
+
+  uint8_t t = tail;
+
+  if (t == head) {
+	return false;
+  }
+
+  //
+  //  Copy the event and only then hand its slot back to the producer
+  //
+  *event = events[t & QUEUE_MASK];
+  QUEUE_BARRIER();
+  tail = t + 1;
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the number of queued events.
+ *
+ *---------------------------------------------------------------------------*/
+uint8_t TouchEventQueue::size() {
+  return (uint8_t)(head - tail);
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if no events are queued.
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchEventQueue::isEmpty() {
+  return head == tail;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Discard all queued events. Should only be called by the consumer.
+ *
+ *---------------------------------------------------------------------------*/
+void TouchEventQueue::clear() {
+  tail = head;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Zero the overflow counters and the high water mark.
+ *
+ *---------------------------------------------------------------------------*/
+void TouchEventQueue::resetStatistics() {
+  overflows = 0;
+  dropped   = 0;
+  highWater = size();
+}
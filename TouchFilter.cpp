@@ -0,0 +1,191 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TouchFilter.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+/*==============================================================================
+ *
+ *  The filter pipeline every raw touch sample passes in getRawTouchData().
+ *  Each stage can be configured at run time, which trades latency for
+ *  jitter. The stages are applied in this order:
+ *
+ *  Pressure gate   Samples with a pressure outside minPressure and
+ *                  maxPressure count as not pressed.
+ *  Dip bridging    If the pressure dips for at most bridgeTime ms, the
+ *                  touch stays pressed at its last position. This is the
+ *                  15 ms filter the touch panel used to have built in.
+ *  Median          The median of the last medianSize pressed samples,
+ *                  removes single spikes at the cost of some latency.
+ *  IIR smoothing   Each sample moves the position 1/2^iirShift of the way
+ *                  towards it, removes jitter at the cost of lag.
+ *
+ *  The median window and the smoothing start over with every touch. All
+ *  stages use integer math on a window of at most TOUCH_FILTER_WINDOW
+ *  samples.
+ *
+ *  The dead band and the minimum interval are applied by
+ *  TouchHandler::digest() on the screen coordinates.
+ *
+ *============================================================================*/
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Filter a raw sample. Returns whether the touch panel counts as pressed.
+ *
+ *  sample       The raw sample, filtered in place
+ *  pressed      Whether the touch panel reported it as pressed
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchFilter::apply(XY* sample, bool pressed) {
+
+  //
+  //  Pressure gate
+  //
+  if (pressed && (sample->z < minPressure || sample->z > maxPressure))
+	pressed = false;
+
+  //
+  //  Dip bridging
+  //
+  if (!pressed) {
+	if (wasPressed && bridgeTime) {
+	  if (!releasing) {
+		releasing    = true;
+		releaseStamp = sample->stamp;
+	  }
+
+	  if (sample->stamp - releaseStamp < (uint32_t)bridgeTime * 1000) {
+		sample->x = last.x;
+		sample->y = last.y;
+		sample->z = last.z;
+		return true;
+	  }
+	}
+
+	reset();
+	return false;
+  }
+
+  wasPressed = true;
+  releasing  = false;
+
+  //
+  //  Median of the last samples
+  //
+  if (medianSize > 1) {
+	xs[head] = sample->x;
+	ys[head] = sample->y;
+	head     = (head + 1) % TOUCH_FILTER_WINDOW;
+	if (count < TOUCH_FILTER_WINDOW)
+	  count++;
+
+	sample->x = median(xs);
+	sample->y = median(ys);
+  }
+
+  //
+  //  IIR smoothing
+  //
+  if (iirShift) {
+	if (!smoothing) {
+	  iirX      = (int32_t)sample->x << 4;
+	  iirY      = (int32_t)sample->y << 4;
+	  smoothing = true;
+	}
+	else {
+	  iirX += (((int32_t)sample->x << 4) - iirX) >> iirShift;
+	  iirY += (((int32_t)sample->y << 4) - iirY) >> iirShift;
+	}
+
+	sample->x = (iirX + 8) >> 4;
+	sample->y = (iirY + 8) >> 4;
+  }
+
+  last = *sample;
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Forget the samples of the touch in progress.
+ *
+ *---------------------------------------------------------------------------*/
+void TouchFilter::reset() {
+  count      = 0;
+  head       = 0;
+  smoothing  = false;
+  wasPressed = false;
+  releasing  = false;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the median of the newest min(medianSize, count) values of the
+ *  window.
+ *
+ *  values       The window of X or Y coordinates
+ *
+ *---------------------------------------------------------------------------*/
+int16_t TouchFilter::median(int16_t* values) {
+
+  uint8_t n = medianSize < count ? medianSize : count;
+  if (n > TOUCH_FILTER_WINDOW)
+	n = TOUCH_FILTER_WINDOW;
+
+  //
+  //  Insertion sort of a copy of the newest n values
+  //
+  int16_t sorted[TOUCH_FILTER_WINDOW];
+  for (uint8_t i = 0; i < n; i++) {
+	int16_t v = values[(head + TOUCH_FILTER_WINDOW - 1 - i) % TOUCH_FILTER_WINDOW];
+	int8_t  j = i - 1;
+
+	while (j >= 0 && sorted[j] > v) {
+	  sorted[j + 1] = sorted[j];
+	  j--;
+	}
+	sorted[j + 1] = v;
+  }
+
+  return sorted[n >> 1];
+}
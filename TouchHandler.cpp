@@ -47,7 +47,6 @@
 #define DEBUG_DIGEST       0
 #define DEBUG_NORMALIZE    0
 
-#define XY_DELTA_THRESHOLD 5	// Ignore touch XY's which are LEQ than this
 
 /*-----------------------------------------------------------------------------
  *
@@ -66,7 +65,34 @@ TouchHandler::TouchHandler() :
  *
  *------------------------------------------------------------------------------------------------*/
 void TouchHandler::exec() {
-  digest();
+
+  //
+  //  With adaptive polling not every tick polls the touch panel, the end
+  //  of the frame below is done every tick anyway
+  //
+  bool poll = true;
+  if (adaptivePolling) {
+	unsigned long now = currentTime();
+
+	updatePollMode(now);
+	poll = now - lastPoll >= pollInterval;
+	if (poll)
+	  lastPoll = now;
+  }
+
+  if (poll)
+	digest();
+
+  //
+  //  At most one DRAW event per drawInterval in drag mode
+  //
+  if (pendingDraw && currentTime() - lastDrawTime >= drawInterval)
+	flushDraw();
+
+  //
+  //  End of the frame, repaint what has been invalidated
+  //
+  Screen.repaint();
 }
 
 /*--------------------------------------------------------------------------------------------------
@@ -78,6 +104,17 @@ bool TouchHandler::tapOrTimeout(long timeout) {
 	return countDownWait(timeout/1000);
 }
 
+/*--------------------------------------------------------------------------------------------------
+ *
+ *  Same as tapOrTimeout(), but returns immediately. The TapWait task counts
+ *  down and calls done() with true if tapped, otherwise false. Returns false
+ *  if TapWait is already waiting for another tap.
+ *
+ *------------------------------------------------------------------------------------------------*/
+bool TouchHandler::tapOrTimeout(long timeout, void (*done)(bool tapped)) {
+	return TapWait.start(timeout, done, true);
+}
+
 /*---------------------------------------------------------------------------------------
  *
  *  Assign the X axis arrays with calibration marker data
@@ -93,6 +130,7 @@ void TouchHandler::setXCalibration(uint16_t size, uint16_t* markers) {
 
   rawAvgXMarkerDistance = (float)(markers[xSize-1] - markers[0])/ (float)xSize; 
 
+  buildTable(&xTable, xCalibration, xSize);
 }
 
 /*---------------------------------------------------------------------------------------
@@ -110,6 +148,7 @@ void TouchHandler::setYCalibration(uint16_t size, uint16_t* markers) {
 
   rawAvgYMarkerDistance = (float)(markers[ySize-1] - markers[0])/ (float)ySize; 
 
+  buildTable(&yTable, yCalibration, ySize);
 }
 
 /*---------------------------------------------------------------------------------------
@@ -124,6 +163,186 @@ void TouchHandler::setMarkerDistance(uint16_t distance) {
 
   markerDistance = distance;
 
+  //
+  //  The slopes depend on the marker distance
+  //
+  if (xCalibration)
+    buildTable(&xTable, xCalibration, xSize);
+  if (yCalibration)
+    buildTable(&yTable, yCalibration, ySize);
+}
+
+/*---------------------------------------------------------------------------------------
+ *
+ *  Use an affine calibration instead of the calibration of the axes and the
+ *  mesh. The calibration is copied.
+ *
+ *  pAffine   The affine calibration, nullptr to use the axes again
+ *
+ *-------------------------------------------------------------------------------------*/
+void TouchHandler::setAffineCalibration(AffineCalibration* pAffine) {
+
+  useAffine = pAffine != nullptr;
+
+  if (pAffine)
+    affine = *pAffine;
+}
+
+/*---------------------------------------------------------------------------------------
+ *
+ *  Returns true if the affine calibration is used.
+ *
+ *-------------------------------------------------------------------------------------*/
+bool TouchHandler::isAffine() {
+  return useAffine;
+}
+
+/*---------------------------------------------------------------------------------------
+ *
+ *  Build the transform getTouch() uses to convert the normalized coordinates
+ *  to the screen rotation. Called by Screen.setRotation(), so the rotation is
+ *  not looked up for every sample. The screen size is that of rotation 0.
+ *
+ *    Rotation   X                 Y
+ *    0          x                 height - y
+ *    1          width - x         height - y
+ *    2          width - x         y
+ *    3          x                 y
+ *
+ *  pRotation  The screen rotation, 0 to 3
+ *
+ *-------------------------------------------------------------------------------------*/
+void TouchHandler::setRotation(uint8_t pRotation) {
+
+  pRotation &= 3;
+
+  bool flipX = pRotation == 1 || pRotation == 2;
+  bool flipY = pRotation == 0 || pRotation == 1;
+
+  xFlip   = flipX ? -1 : 0;
+  xOffset = flipX ? Screen.width  : 0;
+  yFlip   = flipY ? -1 : 0;
+  yOffset = flipY ? Screen.height : 0;
+
+  //
+  //  The bias is in screen coordinates of the old rotation
+  //
+  drift.forget();
+}
+
+/*---------------------------------------------------------------------------------------
+ *
+ *  The drift of the touches is detected. If autoCorrect is set and the total
+ *  correction stays within maxCorrection pixels, it is corrected. Otherwise
+ *  a DRIFT event is dispatched to the screen, with the drift in pixels.
+ *
+ *  now       The time of the touch that detected it
+ *
+ *-------------------------------------------------------------------------------------*/
+void TouchHandler::checkDrift(unsigned long now) {
+
+  drift.detections++;
+
+  int16_t dx = (drift.biasX + 8) >> 4;
+  int16_t dy = (drift.biasY + 8) >> 4;
+
+  //
+  //  The correction is in normalized coordinates, so it holds in any
+  //  rotation. A flipped axis runs the other way.
+  //
+  int16_t cx = drift.correctionX - ((dx ^ xFlip) - xFlip);
+  int16_t cy = drift.correctionY - ((dy ^ yFlip) - yFlip);
+
+  drift.forget();
+
+  if (drift.autoCorrect && abs(cx) <= drift.maxCorrection && abs(cy) <= drift.maxCorrection) {
+    drift.correctionX = cx;
+    drift.correctionY = cy;
+    return;
+  }
+
+  dispatch(TouchEvents::DRIFT, now, dx, dy, &Screen);
+}
+
+/*---------------------------------------------------------------------------------------
+ *
+ *  Build the lookup table used to normalize the raw coordinates of an axis.
+ *
+ *  For every segment between two markers the number of pixels per raw unit
+ *  is stored as a Q16 fixed point value. The raw value range is divided in at
+ *  most NORMALIZE_BUCKETS buckets of a power of two width, each holding the
+ *  segment its first raw value falls in. Normalizing then takes a shift, a
+ *  table lookup, at most a few compares, a multiply and a shift.
+ *
+ *  If the markers are not ascending, or there are too many of them, no table
+ *  is built and normalize() falls back to the float calculation.
+ *
+ *  table     The table to build
+ *  data      The raw marker values
+ *  size      The number of markers
+ *
+ *-------------------------------------------------------------------------------------*/
+void TouchHandler::buildTable(NormalizeTable* table, uint16_t* data, uint16_t size) {
+
+  free(table->slope);
+  free(table->bucket);
+  table->slope  = nullptr;
+  table->bucket = nullptr;
+
+  if (size < 2 || size > 256)
+    return;
+
+  for (uint16_t i = 1; i < size; i++)
+    if (data[i] < data[i-1])
+      return;
+
+  table->slope  = (uint32_t*) malloc((size-1) * sizeof(uint32_t));
+  table->bucket = (uint8_t*)  malloc(NORMALIZE_BUCKETS);
+  if (! table->slope || ! table->bucket) {
+    free(table->slope);
+    free(table->bucket);
+    table->slope  = nullptr;
+    table->bucket = nullptr;
+    return;
+  }
+
+  //
+  //  Pixels per raw unit for each segment, rounded
+  //
+  for (uint16_t i = 0; i < size-1; i++) {
+    uint16_t range = data[i+1] - data[i];
+    table->slope[i] = range ? (((uint32_t)markerDistance << 16) + range/2) / range : 0;
+  }
+
+  //
+  //  Smallest bucket width covering the raw range with the available buckets
+  //
+  uint16_t range = data[size-1] - data[0];
+  table->shift   = 0;
+  while ((range >> table->shift) >= NORMALIZE_BUCKETS)
+    table->shift++;
+
+  //
+  //  The float calculation estimates the marker index as raw / average marker
+  //  distance and clamps to the highest pixel once that estimate reaches size.
+  //  Find the raw value where that happens, so both calculations agree.
+  //
+  float avg    = (float)range / (float)size;
+  table->limit = data[size-1];
+  while (table->limit > data[0] + 1 &&
+         round((float)(table->limit - 1 - data[0]) / avg) >= size)
+    table->limit--;
+
+  //
+  //  For each bucket the last segment starting at or before the bucket start
+  //
+  uint8_t segment = 0;
+  for (uint16_t b = 0; b < NORMALIZE_BUCKETS; b++) {
+    uint32_t start = data[0] + ((uint32_t)b << table->shift);
+    while (segment < size-2 && data[segment+1] <= start)
+      segment++;
+    table->bucket[b] = segment;
+  }
 }
 
 /*---------------------------------------------------------------------------------------
@@ -140,11 +359,6 @@ uint16_t TouchHandler::normalize(uint16_t raw, uint16_t* data, uint16_t size, fl
 #if DEBUG_NORMALIZE
   Serial.print(F("Raw: ")); Serial.println(raw);
 #endif
-  //
-  // Get the rotation
-  //
-  uint8_t rotation = Screen.tft->getRotation();
-
   //
   // find minimum and maximum values
   //
@@ -316,6 +530,39 @@ uint16_t TouchHandler::normalize(uint16_t raw, uint16_t* data, uint16_t size, fl
   return result;
 }
 
+/*---------------------------------------------------------------------------------------
+ *
+ *  Normalize a single coordinate using the lookup table of its axis.
+ *  Gives the same result as the float calculation above, apart from
+ *  rounding differences of at most one pixel.
+ *
+ *  raw             The raw value to normalize
+ *  data            The array of raw calibrated marker values for the pixel cells
+ *  size            The number of markers
+ *  table           The lookup table built from data by buildTable()
+ *
+ *-------------------------------------------------------------------------------------*/
+uint16_t TouchHandler::normalize(uint16_t raw, uint16_t* data, uint16_t size, NormalizeTable* table) {
+
+  if (raw <= data[0]) {
+    return 0;
+  }
+
+  if (raw >= table->limit) {
+    return (markerDistance * (size-1))-1;
+  }
+
+  //
+  //  Find the segment: the last marker at or below raw
+  //
+  uint8_t i = table->bucket[(uint16_t)(raw - data[0]) >> table->shift];
+  while (data[i+1] <= raw) {
+    i++;
+  }
+
+  return markerDistance * i + (((uint32_t)(raw - data[i]) * table->slope[i] + 0x8000) >> 16);
+}
+
 /*---------------------------------------------------------------------------------------
  *
  *  Normalize so that the X,Y touch coordinates are equal to the screen coordinates.
@@ -323,6 +570,25 @@ uint16_t TouchHandler::normalize(uint16_t raw, uint16_t* data, uint16_t size, fl
  *-------------------------------------------------------------------------------------*/
 void TouchHandler::normalize(XY* touch) {
 
+  //
+  //  An affine calibration takes a few integer multiply-adds
+  //
+  if (useAffine) {
+    int32_t x = (affine.xx * touch->x + affine.xy * touch->y + affine.x0) >> 16;
+    int32_t y = (affine.yx * touch->x + affine.yy * touch->y + affine.y0) >> 16;
+
+    touch->x  = x < 0 ? 0 : (x >= affine.width  ? affine.width  - 1 : x);
+    touch->y  = y < 0 ? 0 : (y >= affine.height ? affine.height - 1 : y);
+    return;
+  }
+
+  if (fastNormalize && xTable.slope && yTable.slope) {
+    touch->x = normalize(touch->x, xCalibration, xSize, &xTable);
+    touch->y = normalize(touch->y, yCalibration, ySize, &yTable);
+    mesh.apply(touch);
+    return;
+  }
+
 #if DEBUG_NORMALIZE
   Serial.println(F("X ---> "));
 #endif
@@ -335,6 +601,7 @@ void TouchHandler::normalize(XY* touch) {
 
   touch->y = normalize(touch->y, yCalibration, ySize, rawAvgYMarkerDistance);
 
+  mesh.apply(touch);
 }
 
 /*---------------------------------------------------------------------------------------
@@ -350,26 +617,15 @@ bool  TouchHandler::getTouch(XY* touchData) {
   if (pressedNow) {
     normalize(touchData);
 
+    touchData->x += drift.correctionX;
+    touchData->y += drift.correctionY;
+
     //
-    //  Convert the x and y coordinates depending on the screen rotation
+    //  Convert the x and y coordinates to the screen rotation, with the
+    //  transform built by setRotation(). A flip of -1 negates the coordinate.
     //
-    uint16_t tmp;
-    switch (Screen.tft->getRotation()) {
-    case 0:
-    	touchData->y = Screen.height - touchData->y;
-    	break;
-    case 1:
-    	tmp          = touchData->x;
-    	touchData->y = Screen.height - touchData->y;
-    	touchData->x = Screen.width  - tmp;
-    	break;
-    case 2:
-    	touchData->x = Screen.width - touchData->x;
-    	break;
-    case 3:
-    	// No conversion needed
-    	break;
-    }
+    touchData->x = ((touchData->x ^ xFlip) - xFlip) + xOffset;
+    touchData->y = ((touchData->y ^ yFlip) - yFlip) + yOffset;
 
     return true;
   }
@@ -391,14 +647,58 @@ bool TouchHandler::digest( ){
 
   /**** G E T   F R E S H   T O U C H   D A T A *****************************************/
 
+  //
+  //  The raw samples are taken over, e.g. by a running calibration
+  //
+  if (rawSampleSink) {
+	XY   raw;
+	bool pressedRaw = getRawTouchData(&raw);
+	uint32_t now    = currentTime();
+
+	samplesTaken++;
+	if (pressedRaw) {
+	  lastActivity  = now;
+	  lastTimestamp = now;                    // Touches keep the screen awake
+	}
+
+	rawSampleSink(&raw, pressedRaw, now);
+	return pressedRaw;
+  }
+
   XY touchData;			                    // Structure in which touch data is returned
   bool pressedNow = getTouch(&touchData);	// Call C-function to gather the data
-  uint32_t now    = millis();
+  uint32_t now    = currentTime();
+
+  sampleStamp     = touchData.stamp;        // Carried by the events, to measure latency
+  samplesTaken++;
+
+  if (pressedNow)
+	lastActivity = now;
+
+  //
+  //  Gestures are recognized on every sample, before any filtering
+  //
+  if (gestures.enabled && !Screen.isVisible())
+	gestures.reset();
+  else if (gestures.enabled) {
+	uint16_t gesture = gestures.sample(pressedNow, touchData.x, touchData.y, now);
+
+	if (gesture != TouchEvents::NONE) {
+	  if (!gestures.matched) {
+		gestures.target  = Screen.match(gestures.startX, gestures.startY);
+		gestures.matched = true;
+	  }
+
+	  dispatch(gesture, now, gestures.x, gestures.y, gestures.target, gestures.vx, gestures.vy);
+	}
+  }
 
   //
   //  Prevent spurious events
   //
-  if (now - lastTimestamp < 100) {
+  //  In drag mode a touch in progress is digested at every sample.
+  //
+  if (!(dragMode && pressed) && now - lastTimestamp < filter.minInterval) {
 	 return false;
   }
 
@@ -423,8 +723,7 @@ bool TouchHandler::digest( ){
 	//
 	if (Screen.isVisible() && now - lastTimestamp > inactivityTimeout) {
 		event = TouchEvents::GOTO_SLEEP;
-		TouchEvent sleep = TouchEvent(event, now, 0, 0, &Screen);
-		Screen.dispatch(&sleep);
+		dispatch(event, now, 0, 0, &Screen);
 	}
 
     return false;    // Ignore this state for anybody else.
@@ -442,8 +741,7 @@ bool TouchHandler::digest( ){
 	 if (! Screen.isVisible()) {
 		 lastTimestamp = now; // Prevent we fall asleep at the next cycle !!!
 		 event = TouchEvents::WAKEUP;
-	     TouchEvent wakeUp(event, now, 0, 0, &Screen);
-	     Screen.dispatch(&wakeUp);   // Dispatch WAKEUP event for it.
+	     dispatch(event, now, 0, 0, &Screen);   // Dispatch WAKEUP event for it.
 
 	     return false;          // Ignore the touch for anybody else
 	 }
@@ -460,7 +758,7 @@ bool TouchHandler::digest( ){
   int16_t dy = y - touchData.y;
   if (dy < 0) dy = -dy;
 
-  if (dx <= XY_DELTA_THRESHOLD && dy <= XY_DELTA_THRESHOLD) {
+  if (dx <= filter.deadBand && dy <= filter.deadBand) {
     return false;
   }
 
@@ -525,7 +823,7 @@ bool TouchHandler::digest( ){
  /***** D I G E S T   T O U C H   D A T A **********************************************/
 
   event      = TouchEvents::NONE;	// By default we assume no event
-  timestamp  = millis();		    // Register a timestamp
+  timestamp  = currentTime();	    // Register a timestamp
 
   //------------------------------------------------------------------
   //
@@ -557,14 +855,12 @@ bool TouchHandler::digest( ){
 
     	if (lastSource) {
     	  event = TouchEvents::OUT_OF_SCOPE;
-    	  TouchEvent oos(event, timestamp, x, y, lastSource);
-    	  Screen.dispatch(&oos);
+    	  dispatch(event, timestamp, x, y, lastSource);
     	}
 
     	if (source) {
     	  event = TouchEvents::IN_SCOPE;
-    	  TouchEvent is(event, timestamp, x, y, source);
-    	  Screen.dispatch(&is);
+    	  dispatch(event, timestamp, x, y, source);
     	}
     }
 
@@ -580,8 +876,14 @@ bool TouchHandler::digest( ){
 
       event    = TouchEvents::TOUCH;			// Set the TOUCH event type
 
-      TouchEvent touch(event, timestamp, x, y, source);	// Create the TOUCH event
-      Screen.dispatch(&touch);				// Dispatch it
+      if (drift.enabled)
+        drift.touch(x, y, timestamp);           // A ButtonWidget reports a hit
+
+      dispatch(event, timestamp, x, y, source);	// Create and dispatch the TOUCH event
+
+      if (drift.detected)
+        checkDrift(timestamp);
+
       return pressedNow;
     }
 
@@ -596,8 +898,23 @@ bool TouchHandler::digest( ){
 
     event     = TouchEvents::DRAW;			// Set the DRAW event type
 
-    TouchEvent draw(event, timestamp, x, y, source);	// Create the TOUCH event
-    Screen.dispatch(&draw);				// Dispatch it
+    //
+    //  In drag mode only the latest DRAW is kept, flushDraw() dispatches it
+    //
+    if (dragMode) {
+      if (pendingDraw)
+    	drawsCoalesced++;
+
+      pendingDraw      = true;
+      pendingTimestamp = timestamp;
+      pendingX         = x;
+      pendingY         = y;
+      pendingSource    = source;
+      pendingStamp     = sampleStamp;
+      return pressedNow;
+    }
+
+    dispatch(event, timestamp, x, y, source);	// Create and dispatch the DRAW event
     return pressedNow;
   }
 
@@ -628,12 +945,10 @@ bool TouchHandler::digest( ){
           #endif
    
           event  = TouchEvents::UNTOUCH;	// Set the UNTOUCH event type
-          TouchEvent untouch(event, timestamp, lastX, lastY, source);
-          Screen.dispatch(&untouch);
+          dispatch(event, timestamp, lastX, lastY, source);
 
           event  = TouchEvents::OUT_OF_SCOPE;
-          TouchEvent oos(event, timestamp, lastX, lastY, source);
-          Screen.dispatch(&oos);
+          dispatch(event, timestamp, lastX, lastY, source);
 
           source = nullptr;     // Back to reality, no source was pressed on
           return pressedNow;
@@ -651,6 +966,127 @@ bool TouchHandler::digest( ){
   return pressedNow;
 }
 
+/*------------------------------------------------------------------------------
+ *
+ *  Acquires an event from the EventPool, dispatches it and releases it again.
+ *  Should the pool be exhausted, the event is created on the stack instead,
+ *  which is fine for a synchronous dispatch. The miss is counted by the pool.
+ *
+ *  pEvent      The event code
+ *  timeStamp   The time stamp of the event
+ *  pX          The x-coordinate of the event
+ *  pY          The y-coordinate of the event
+ *  pSource     The widget receiving the event
+ *  pVx, pVy    The velocity, for gesture events
+ *
+ *----------------------------------------------------------------------------*/
+void TouchHandler::dispatch(uint16_t      pEvent,
+		                    unsigned long timeStamp,
+		                    int16_t       pX,
+		                    int16_t       pY,
+		                    EventSource*  pSource,
+		                    int16_t       pVx,
+		                    int16_t       pVy) {
+
+  //
+  //  A pending DRAW happened before this event
+  //
+  if (pendingDraw)
+	flushDraw();
+
+  eventsDispatched++;
+
+  TouchEvent* e = EventPool.acquire(pEvent, timeStamp, pX, pY, pSource);
+
+  if (e) {
+	e->rawStamp = sampleStamp;
+	e->vx       = pVx;
+	e->vy       = pVy;
+	TouchLog.event(e);
+	Screen.dispatch(e);
+	EventPool.release(e);
+	return;
+  }
+
+  TouchEvent local(pEvent, timeStamp, pX, pY, pSource);
+  local.rawStamp = sampleStamp;
+  local.vx       = pVx;
+  local.vy       = pVy;
+  TouchLog.event(&local);
+  Screen.dispatch(&local);
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Chooses how often the touch panel is polled. While touched and for
+ *  activeHold ms after, it is polled every activeInterval ms. Then the
+ *  interval doubles every idleStep ms, up to idleInterval. While the screen
+ *  sleeps it is polled every sleepInterval ms, to detect the wake up touch.
+ *  The time spent in each mode is added to timeInMode.
+ *
+ *  now         The current time in ms
+ *
+ *----------------------------------------------------------------------------*/
+void TouchHandler::updatePollMode(unsigned long now) {
+
+  if (lastModeUpdate)
+	timeInMode[pollMode] += now - lastModeUpdate;
+  lastModeUpdate        = now;
+
+  if (!Screen.isVisible()) {
+	pollMode     = TOUCH_POLL_SLEEP;
+	pollInterval = sleepInterval;
+	return;
+  }
+
+  unsigned long quiet = now - lastActivity;
+
+  if (pressed || quiet < activeHold) {
+	pollMode     = TOUCH_POLL_ACTIVE;
+	pollInterval = activeInterval;
+	return;
+  }
+
+  pollMode = TOUCH_POLL_IDLE;
+
+  uint32_t interval = activeInterval;
+  for (unsigned long t = quiet - activeHold; idleStep && t >= idleStep && interval < idleInterval; t -= idleStep)
+	interval <<= 1;
+
+  pollInterval = interval < idleInterval ? interval : idleInterval;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Dispatches the DRAW event kept in drag mode, if any. It is called by exec()
+ *  at most once per drawInterval. If you call digest() from loop(), call it
+ *  before repainting.
+ *
+ *----------------------------------------------------------------------------*/
+void TouchHandler::flushDraw() {
+
+  if (!pendingDraw)
+	return;
+
+  pendingDraw    = false;
+  lastDrawTime   = currentTime();
+
+  uint32_t stamp = sampleStamp;
+  sampleStamp    = pendingStamp;
+  dispatch(TouchEvents::DRAW, pendingTimestamp, pendingX, pendingY, pendingSource);
+  sampleStamp    = stamp;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Returns the current time in milliseconds. That is millis(), unless a clock
+ *  is set. A fast replay sets it, so time passes as recorded.
+ *
+ *----------------------------------------------------------------------------*/
+unsigned long TouchHandler::currentTime() {
+  return clock ? clock() : millis();
+}
+
 /*------------------------------------------------------------------------------
  *
  *  Copies the current time stamp, event, x, y and source as the last event data
@@ -0,0 +1,193 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TouchMesh.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+/*==============================================================================
+ *
+ *  The calibration of the touch panel measures a single row for the X axis
+ *  and a single column for the Y axis, normalize() then treats both axes as
+ *  independent. Cheap resistive panels are skewed, especially near the
+ *  corners. The mesh corrects that.
+ *
+ *  TOUCH_MESH_COLS x TOUCH_MESH_ROWS nodes are spread evenly over the screen,
+ *  including its edges: node (col, row) is at the normalized coordinates
+ *  (col * width / (TOUCH_MESH_COLS-1), row * height / (TOUCH_MESH_ROWS-1)). For every node the calibration measured how far the
+ *  normalized coordinates are off, in whole pixels. Between the nodes the
+ *  correction is interpolated bilinearly, in fixed point:
+ *
+ *    c(u, v) = a + b*u + c*v + d*u*v           u, v in [0, 1] within a cell
+ *
+ *  The coefficients a, b, c and d of every cell are calculated once by
+ *  build(), so apply() only has to find the cell and evaluate it. This takes
+ *  a couple of multiplications per axis, no divisions.
+ *
+ *  The mesh works on normalized coordinates, before the rotation is applied,
+ *  so it is valid in any rotation.
+ *
+ *============================================================================*/
+
+/*------------------------------------------------------------------------------
+ *
+ *  Builds the coefficient cache.
+ *
+ *  pWidth, pHeight   The extent of the normalized coordinates, i.e. the
+ *                    screen size in rotation 0
+ *  corrections       Per node, row by row, the X and Y correction in pixels
+ *
+ *  Returns false if the cache could not be allocated.
+ *
+ *----------------------------------------------------------------------------*/
+bool TouchMesh::build(int16_t pWidth, int16_t pHeight, const int8_t* corrections) {
+
+  if (!cells)
+    cells = (MeshCell*)malloc(TOUCH_MESH_CELLS * sizeof(MeshCell));
+
+  if (!cells)
+    return false;
+
+  width    = pWidth;
+  height   = pHeight;
+  colScale = ((uint32_t)(TOUCH_MESH_COLS - 1) << 16) / width;
+  rowScale = ((uint32_t)(TOUCH_MESH_ROWS - 1) << 16) / height;
+
+  MeshCell* cell = cells;
+  for (uint8_t row = 0; row < TOUCH_MESH_ROWS - 1; row++) {
+    for (uint8_t col = 0; col < TOUCH_MESH_COLS - 1; col++, cell++) {
+
+      const int8_t* n00 = corrections + 2 * (row * TOUCH_MESH_COLS + col);
+      const int8_t* n10 = n00 + 2;
+      const int8_t* n01 = n00 + 2 * TOUCH_MESH_COLS;
+      const int8_t* n11 = n01 + 2;
+
+      for (uint8_t axis = 0; axis < 2; axis++) {
+        int16_t* k = axis ? cell->y : cell->x;
+
+        k[0] = n00[axis];
+        k[1] = n10[axis] - n00[axis];
+        k[2] = n01[axis] - n00[axis];
+        k[3] = n11[axis] - n10[axis] - n01[axis] + n00[axis];
+      }
+    }
+  }
+
+  return true;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Releases the cache, apply() no longer corrects anything.
+ *
+ *----------------------------------------------------------------------------*/
+void TouchMesh::clear() {
+
+  free(cells);
+  cells = nullptr;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  True if apply() corrects the coordinates.
+ *
+ *----------------------------------------------------------------------------*/
+bool TouchMesh::isEnabled() {
+  return cells != nullptr;
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Evaluates a bilinear correction, u and v in Q8 and rounded.
+ *
+ *----------------------------------------------------------------------------*/
+static inline int16_t bilinear(const int16_t* k, int16_t u, int16_t v) {
+
+  int32_t uv = ((int32_t)u * v) >> 8;
+
+  return k[0] + (int16_t)(((int32_t)k[1] * u + (int32_t)k[2] * v + (int32_t)k[3] * uv + 128) >> 8);
+}
+
+/*------------------------------------------------------------------------------
+ *
+ *  Corrects normalized coordinates, if a mesh is built.
+ *
+ *  touch      The normalized coordinates
+ *
+ *----------------------------------------------------------------------------*/
+void TouchMesh::apply(XY* touch) {
+
+  if (!cells)
+    return;
+
+  int16_t x = touch->x < 0 ? 0 : touch->x;
+  int16_t y = touch->y < 0 ? 0 : touch->y;
+
+  //
+  //  The cell and the position within it, in Q8
+  //
+  uint32_t cellX = ((uint32_t)x * colScale) >> 8;
+  uint32_t cellY = ((uint32_t)y * rowScale) >> 8;
+  uint16_t col   = cellX >> 8;
+  uint16_t row   = cellY >> 8;
+  int16_t  u     = cellX & 0xff;
+  int16_t  v     = cellY & 0xff;
+
+  if (col >= TOUCH_MESH_COLS - 1) {
+    col = TOUCH_MESH_COLS - 2;
+    u   = 256;
+  }
+
+  if (row >= TOUCH_MESH_ROWS - 1) {
+    row = TOUCH_MESH_ROWS - 2;
+    v   = 256;
+  }
+
+  MeshCell* cell = &cells[row * (TOUCH_MESH_COLS - 1) + col];
+
+  x += bilinear(cell->x, u, v);
+  y += bilinear(cell->y, u, v);
+
+  //
+  //  Stay on the screen
+  //
+  touch->x = x < 0 ? 0 : (x >= width  ? width  - 1 : x);
+  touch->y = y < 0 ? 0 : (y >= height ? height - 1 : y);
+}
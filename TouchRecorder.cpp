@@ -0,0 +1,410 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <TouchRecorder.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+/*==============================================================================
+ *
+ *  Records the raw touch samples and the TouchEvents resulting from them to
+ *  a compact binary log, and replays such a log in place of the touch panel.
+ *  Replaying the same log gives the same workload every time, to benchmark
+ *  digest(), match(), dispatching and drawing, or to compare releases.
+ *
+ *  The log starts with the bytes 'T', 'L' and TOUCH_LOG_VERSION. Then the
+ *  records follow, each starting with a tag byte and the time passed since
+ *  the previous record in microseconds, as a varint (7 bits per byte, least
+ *  significant first, the high bit set if more bytes follow):
+ *
+ *    TOUCH_LOG_RELEASED, TOUCH_LOG_PRESSED   time, x, y, z
+ *    TOUCH_LOG_EVENT                         time, event code (varint), x, y
+ *
+ *  The coordinates are little endian 16-bit integers. Sample coordinates are
+ *  raw, event coordinates are screen coordinates.
+ *
+ *  A replay in real time hands out every sample once its recorded time has
+ *  come, and repeats the last one until then. A fast replay hands out a new
+ *  sample on every poll and makes the TouchHandler see the recorded time, so
+ *  it generates the recorded events. The replayed events are compared to the
+ *  recorded ones, mismatches counts the differences.
+ *
+ *============================================================================*/
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Start recording to a Print, e.g. a file. Returns false if the recorder
+ *  is already recording or replaying.
+ *
+ *  pOut         Where the log is written to
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchRecorder::record(Print* pOut) {
+
+  if (out || in)
+	return false;
+
+  out        = pOut;
+  samples    = 0;
+  events     = 0;
+  mismatches = 0;
+  lastStamp  = micros();
+
+  out->write('T');
+  out->write('L');
+  out->write((uint8_t)TOUCH_LOG_VERSION);
+
+  source         = rawTouchSource;
+  rawTouchSource = recordSample;
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Start replaying a log in place of the touch panel. The stream must not
+ *  have to wait for its data, like a file. Returns false if the recorder is
+ *  busy, or if the stream does not hold a log of this version.
+ *
+ *  pIn          Where the log is read from
+ *  pRealtime    true: at the recorded pace, false: as fast as polled
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchRecorder::replay(Stream* pIn, bool pRealtime) {
+
+  if (out || in)
+	return false;
+
+  if (pIn->read() != 'T' || pIn->read() != 'L' || pIn->read() != TOUCH_LOG_VERSION)
+	return false;
+
+  in          = pIn;
+  realtime    = pRealtime;
+  samples     = 0;
+  events      = 0;
+  mismatches  = 0;
+  logTime     = 0;
+  due         = false;
+  pressed     = false;
+  sample.x    = -1;
+  sample.y    = -1;
+  sample.z    = 0;
+  startMicros = micros();
+  startMillis = millis();
+
+  source         = rawTouchSource;
+  rawTouchSource = replaySample;
+
+  if (!realtime)
+	Touch.clock = replayClock;
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Stop recording or replaying. The touch panel is used again.
+ *
+ *---------------------------------------------------------------------------*/
+void TouchRecorder::stop() {
+
+  if (out) {
+	rawTouchSource = source;
+	out            = nullptr;
+  }
+
+  if (in)
+	finish();
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if recording.
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchRecorder::isRecording() {
+  return out != nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if replaying. At the end of the log it stops by itself.
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchRecorder::isReplaying() {
+  return in != nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Called for every event the TouchHandler dispatches. While recording it is
+ *  written to the log. While replaying it is compared to the next recorded
+ *  event.
+ *
+ *  e            The event being dispatched
+ *
+ *---------------------------------------------------------------------------*/
+void TouchRecorder::event(TouchEvent* e) {
+
+  if (out) {
+	uint32_t now = micros();
+
+	out->write((uint8_t)TOUCH_LOG_EVENT);
+	writeVarint(now - lastStamp);
+	writeVarint(e->event);
+	writeInt16(e->x);
+	writeInt16(e->y);
+
+	lastStamp = now;
+	events++;
+	return;
+  }
+
+  if (!in)
+	return;
+
+  events++;
+
+  uint32_t delta;
+  uint32_t code;
+  int16_t  x;
+  int16_t  y;
+
+  if (in->peek() != TOUCH_LOG_EVENT) {
+	mismatches++;
+	return;
+  }
+
+  in->read();
+  if (!readVarint(&delta) || !readVarint(&code) || !readInt16(&x) || !readInt16(&y)) {
+	mismatches++;
+	return;
+  }
+
+  logTime += delta;
+
+  if (code != e->event || x != e->x || y != e->y)
+	mismatches++;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  The raw touch source while recording. It takes the sample from the
+ *  source that was set before, or from the touch panel, and logs it.
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchRecorder::recordSample(XY* data) {
+
+  TouchRecorder& r = TouchLog;
+
+  bool isPressed = r.source ? r.source(data) : readTouchPanel(data);
+
+  r.out->write((uint8_t)(isPressed ? TOUCH_LOG_PRESSED : TOUCH_LOG_RELEASED));
+  r.writeVarint(data->stamp - r.lastStamp);
+  r.writeInt16(data->x);
+  r.writeInt16(data->y);
+  r.writeInt16(data->z);
+
+  r.lastStamp = data->stamp;
+  r.samples++;
+
+  return isPressed;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  The raw touch source while replaying. At the end of the log the replay
+ *  stops and the panel reports it is not pressed.
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchRecorder::replaySample(XY* data) {
+
+  TouchRecorder& r = TouchLog;
+
+  if (!r.realtime) {
+	if (!r.readSample(&r.sample, &r.pressed)) {
+	  r.finish();
+	  return readTouchPanel(data);
+	}
+
+	//
+	//  Time passes as recorded, also for the filters
+	//
+	data->stamp = r.startMicros + r.logTime;
+  }
+  else {
+	if (!r.due) {
+	  if (!r.readSample(&r.next, &r.nextPressed)) {
+		r.finish();
+		return readTouchPanel(data);
+	  }
+	  r.due = true;
+	}
+
+	//
+	//  Until the next sample is due, the panel stays as it was
+	//
+	if (micros() - r.startMicros >= r.logTime) {
+	  r.sample  = r.next;
+	  r.pressed = r.nextPressed;
+	  r.due     = false;
+	}
+  }
+
+  data->x = r.sample.x;
+  data->y = r.sample.y;
+  data->z = r.sample.z;
+
+  return r.pressed;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  The clock of the TouchHandler during a fast replay, it runs at the time
+ *  of the log.
+ *
+ *---------------------------------------------------------------------------*/
+unsigned long TouchRecorder::replayClock() {
+  return TouchLog.startMillis + TouchLog.logTime / 1000;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Read the next sample from the log. Events still in front of it were not
+ *  generated by the replay, so they count as mismatches. Returns false at
+ *  the end of the log.
+ *
+ *---------------------------------------------------------------------------*/
+bool TouchRecorder::readSample(XY* data, bool* isPressed) {
+
+  for (;;) {
+	int      tag = in->read();
+	uint32_t delta;
+	uint32_t code;
+	int16_t  x;
+	int16_t  y;
+
+	if (tag == TOUCH_LOG_EVENT) {
+	  if (!readVarint(&delta) || !readVarint(&code) || !readInt16(&x) || !readInt16(&y))
+		return false;
+
+	  logTime += delta;
+	  mismatches++;
+	  continue;
+	}
+
+	if (tag != TOUCH_LOG_PRESSED && tag != TOUCH_LOG_RELEASED)
+	  return false;
+
+	if (!readVarint(&delta) || !readInt16(&data->x) || !readInt16(&data->y) || !readInt16(&data->z))
+	  return false;
+
+	logTime   += delta;
+	*isPressed = tag == TOUCH_LOG_PRESSED;
+	samples++;
+
+	return true;
+  }
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Stop replaying, restore the touch source and the clock.
+ *
+ *---------------------------------------------------------------------------*/
+void TouchRecorder::finish() {
+
+  in             = nullptr;
+  rawTouchSource = source;
+
+  if (Touch.clock == replayClock)
+	Touch.clock = nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Write and read the parts of a record.
+ *
+ *---------------------------------------------------------------------------*/
+void TouchRecorder::writeVarint(uint32_t value) {
+
+  while (value >= 0x80) {
+	out->write((uint8_t)(value | 0x80));
+	value >>= 7;
+  }
+
+  out->write((uint8_t)value);
+}
+
+void TouchRecorder::writeInt16(int16_t value) {
+  out->write((uint8_t)value);
+  out->write((uint8_t)((uint16_t)value >> 8));
+}
+
+bool TouchRecorder::readVarint(uint32_t* value) {
+
+  *value = 0;
+
+  for (uint8_t shift = 0; shift < 35; shift += 7) {
+	int c = in->read();
+	if (c < 0)
+	  return false;
+
+	*value |= (uint32_t)(c & 0x7F) << shift;
+	if (!(c & 0x80))
+	  return true;
+  }
+
+  return false;
+}
+
+bool TouchRecorder::readInt16(int16_t* value) {
+
+  int lo = in->read();
+  int hi = in->read();
+
+  if (lo < 0 || hi < 0)
+	return false;
+
+  *value = (int16_t)((uint16_t)lo | ((uint16_t)hi << 8));
+  return true;
+}
+
+TouchRecorder TouchLog;	// Records and replays touches
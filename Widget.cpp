@@ -90,6 +90,15 @@ Widget::Widget(Widget* pParent, int16_t pX, int16_t pY, uint16_t pWidth, uint16_
       visible = true;
 }
 
+/*-------------------------------------------------------------------------------
+ *
+ *  Destructor, virtual so that deleting a widget by a base class pointer
+ *  destroys all of it, e.g. a Calibrator deleted after recalibrating.
+ *
+ *-----------------------------------------------------------------------------*/
+Widget::~Widget() {
+}
+
 /*-----------------------------------------------------------------------------
  *
  *  Add the widget as a child.
@@ -114,6 +123,8 @@ void Widget::add(Widget* w) {
    //  Make the last added child the first one in the sibling chain
    //
    child = w;      // Assign the head of the siblings to the paren child.
+
+   Screen.index.invalidate();   // The widget tree changed
 }
 
 void Widget::tree() {
@@ -263,6 +274,8 @@ void Widget::remove(Widget* w) {
         prev->sibling = w->sibling;   // Remove the sibling from the list.
       }
 
+      Screen.index.invalidate();      // The widget tree changed
+
       //
       //  Mission accomplished
       //
@@ -348,6 +361,23 @@ Widget* Widget::getSibling() {
   return sibling;
 }
     
+/*-------------------------------------------------------------------------------
+ *
+ *  Moves the widget over an X and Y distance.
+ *  As its bounds change, the spatial index of the Screen is invalidated.
+ *  Note that setPosition() and center() end up here as well.
+ *
+ *  deltaX     The distance to move horizontally
+ *  deltaY     The distance to move vertically
+ *
+ *-----------------------------------------------------------------------------*/
+void Widget::move(int16_t deltaX, int16_t deltaY) {
+
+  Area::move(deltaX, deltaY);
+
+  Screen.index.invalidate();
+}
+
 /*-------------------------------------------------------------------------------
  *
  *  Clears the area the widget occupies.
@@ -360,6 +390,27 @@ void Widget::clear() {
       Screen.tft->fillRect(x, y, width, height, BLACK);
 }
 
+/*-------------------------------------------------------------------------------
+ *
+ *  Fills a rectangle on the Screen and adds its size to pixelsWritten.
+ *  Comparing pixelsWritten with the widget its area shows the overdraw.
+ *
+ *  pX         X coordinate
+ *  pY         Y coordinate
+ *  pWidth     Width
+ *  pHeight    Height
+ *  color      Fill color
+ *
+ *-----------------------------------------------------------------------------*/
+void Widget::fill(int16_t pX, int16_t pY, uint16_t pWidth, uint16_t pHeight, uint16_t color) {
+
+  if (pWidth == 0 || pHeight == 0)
+    return;
+
+  pixelsWritten += (uint32_t)pWidth * pHeight;
+  Screen.fillRect(pX, pY, pWidth, pHeight, color);
+}
+
 /*---------------------------------------------------------------------------------
  *
  *  Returns true if the coordinates passed are part of the area the label occupies.
@@ -520,6 +571,29 @@ void Widget::onEvent(TouchEvent* event) {
       onOutOfScope(event);
       break;
 
+    case TouchEvents::LONG_PRESS:
+      onLongPress(event);
+      break;
+
+    case TouchEvents::DOUBLE_TAP:
+      onDoubleTap(event);
+      break;
+
+    case TouchEvents::SWIPE_LEFT:
+    case TouchEvents::SWIPE_RIGHT:
+    case TouchEvents::SWIPE_UP:
+    case TouchEvents::SWIPE_DOWN:
+      onSwipe(event);
+      break;
+
+    case TouchEvents::DRAG:
+      onDrag(event);
+      break;
+
+    case TouchEvents::DRIFT:
+      onDrift(event);
+      break;
+
     default:
       onUnsollicitedEvent(event);
   }
@@ -657,6 +731,76 @@ void Widget::onOutOfScope(TouchEvent* event) {
 #endif
 }
 
+/*----------------------------------------------------------------------
+ *
+ *  Processes a TouchEvent type LONG_PRESS. It is sent once while the
+ *  widget is touched at the same spot for a while.
+ *
+ *  event      The long press event to process
+ *
+ *--------------------------------------------------------------------*/
+void Widget::onLongPress(TouchEvent* event) {
+#if DEBUG_ON_EVENT
+	Serial.print(F("Override onLongPress ")); Serial.println(id);
+#endif
+}
+
+/*----------------------------------------------------------------------
+ *
+ *  Processes a TouchEvent type DOUBLE_TAP.
+ *
+ *  event      The double tap event to process
+ *
+ *--------------------------------------------------------------------*/
+void Widget::onDoubleTap(TouchEvent* event) {
+#if DEBUG_ON_EVENT
+	Serial.print(F("Override onDoubleTap ")); Serial.println(id);
+#endif
+}
+
+/*----------------------------------------------------------------------
+ *
+ *  Processes the TouchEvent types SWIPE_LEFT, SWIPE_RIGHT, SWIPE_UP and
+ *  SWIPE_DOWN. The event its vx and vy hold the velocity when lifted.
+ *
+ *  event      The swipe event to process
+ *
+ *--------------------------------------------------------------------*/
+void Widget::onSwipe(TouchEvent* event) {
+#if DEBUG_ON_EVENT
+	Serial.print(F("Override onSwipe ")); Serial.println(id);
+#endif
+}
+
+/*----------------------------------------------------------------------
+ *
+ *  Processes a TouchEvent type DRAG. It is sent to the widget the touch
+ *  started on, for every move. The event its vx and vy hold the velocity.
+ *
+ *  event      The drag event to process
+ *
+ *--------------------------------------------------------------------*/
+void Widget::onDrag(TouchEvent* event) {
+#if DEBUG_ON_EVENT
+	Serial.print(F("Override onDrag ")); Serial.println(id);
+#endif
+}
+
+/*----------------------------------------------------------------------
+ *
+ *  Processes a TouchEvent type DRIFT. It is sent to the screen when the
+ *  touches are off the buttons, see TouchDrift. The event its x and y
+ *  hold by how many pixels.
+ *
+ *  event      The drift event to process
+ *
+ *--------------------------------------------------------------------*/
+void Widget::onDrift(TouchEvent* event) {
+#if DEBUG_ON_EVENT
+	Serial.print(F("Override onDrift ")); Serial.println(id);
+#endif
+}
+
 /*----------------------------------------------------------------------
  *
  *  If set to true the widget becomes visible.
@@ -701,6 +845,35 @@ void Widget::setVisible(bool pVisible) {
   //
 }
 
+/*----------------------------------------------------------------------
+ *
+ *  Marks the entire area of the widget as damaged.
+ *  Nothing is drawn right away, the Screen repaints the damaged area
+ *  at the next frame. See ScreenHandler::repaint().
+ *
+ *--------------------------------------------------------------------*/
+void Widget::invalidate() {
+
+  invalidate(x, y, width, height);
+}
+
+/*----------------------------------------------------------------------
+ *
+ *  Marks part of the screen as damaged.
+ *  Nothing is drawn right away, the Screen repaints the damaged area
+ *  at the next frame. See ScreenHandler::repaint().
+ *
+ *  pX           X coordinate of the damaged area
+ *  pY           Y coordinate of the damaged area
+ *  pWidth       The width of the damaged area
+ *  pHeight      The height of the damaged area
+ *
+ *--------------------------------------------------------------------*/
+void Widget::invalidate(int16_t pX, int16_t pY, uint16_t pWidth, uint16_t pHeight) {
+
+  Screen.addDamage(pX, pY, pWidth, pHeight);
+}
+
 /*-----------------------------------------------------------------------
  *
  *  Returns true if the widget should be visible
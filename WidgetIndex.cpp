@@ -0,0 +1,281 @@
+/*-------------------------------------------------------------------------------------------------
+
+
+       /////// ////// //////  //////   /////     /////    ////  //    //
+         //   //     //   // //   // //   //    //  //  //   // // //
+        //   ////   //////  //////  ///////    /////   //   //   //
+       //   //     //  //  // //   //   //    //   // //   //  // //
+      //   ////// //   // //   // //   //    //////    ////  //   //
+
+
+                 A R D U I N O   D I S T A N C E  S E N S O R S
+
+
+                 (C) 2024, C. Hofman - cor.hofman@terrabox.nl
+
+               <WidgetIndex.cpp> - Library forGUI Widgets.
+                              16 Aug 2024
+                      Released into the public domain
+                as GitHub project: TerraboxNL/TerraBox_Widgets
+                   under the GNU General public license V3.0
+
+      This program is free software: you can redistribute it and/or modify
+      it under the terms of the GNU General Public License as published by
+      the Free Software Foundation, either version 3 of the License, or
+      (at your option) any later version.
+
+      This program is distributed in the hope that it will be useful,
+      but WITHOUT ANY WARRANTY; without even the implied warranty of
+      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+      GNU General Public License for more details.
+
+      You should have received a copy of the GNU General Public License
+      along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+ *---------------------------------------------------------------------------*
+ *
+ *  C H A N G E  L O G :
+ *  ==========================================================================
+ *  P0001 - Initial release
+ *  ==========================================================================
+ *
+ *--------------------------------------------------------------------------*/
+#include <TerraBox_Widgets.h>
+
+#define DEBUG_INDEX 0
+
+/*==============================================================================
+ *
+ *  A uniform grid over the Screen, used to answer "which widget is at (x,y)"
+ *  without walking the whole widget tree.
+ *
+ *  All widgets below the root are kept in a table in pre-order, i.e. in the
+ *  order Widget::match() would visit them. Each grid cell holds a bit mask
+ *  of the widgets whose bounds overlap it. A query visits only the widgets
+ *  of one cell, in table order, and descends into a widget when it is a
+ *  visible child of the current match that contains the point. Because of
+ *  the pre-order, the first such child found at every level is the one
+ *  Widget::match() would have found, so z-order semantics are identical.
+ *
+ *  Visibility is checked at query time, so setVisible() does not require a
+ *  rebuild. Adding, removing and moving widgets invalidate the index, which
+ *  is then rebuilt lazily at the next query.
+ *
+ *  Widgets overriding contains() must not claim points outside their bounds.
+ *  Trees with more than WIDGET_INDEX_MAX_WIDGETS widgets fall back to
+ *  Widget::match().
+ *
+ *============================================================================*/
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Enables the index for a widget tree. The memory is allocated at the first
+ *  rebuild. Returns false if the widget table could not be allocated.
+ *
+ *  pRoot        The root of the widget tree, normally the Screen
+ *
+ *---------------------------------------------------------------------------*/
+bool WidgetIndex::begin(Widget* pRoot) {
+
+  if (! widgets) {
+	widgets = (Widget**) malloc(WIDGET_INDEX_MAX_WIDGETS * sizeof(Widget*));
+	parents = (uint8_t*) malloc(WIDGET_INDEX_MAX_WIDGETS);
+	if (! widgets || ! parents) {
+	  end();
+	  return false;
+	}
+  }
+
+  root  = pRoot;
+  dirty = true;
+
+  return true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Disables the index and frees its memory.
+ *
+ *---------------------------------------------------------------------------*/
+void WidgetIndex::end() {
+
+  free(widgets);
+  free(parents);
+  free(cells);
+
+  widgets  = nullptr;
+  parents  = nullptr;
+  cells    = nullptr;
+  capacity = 0;
+  root     = nullptr;
+  dirty    = true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns true if the index is enabled.
+ *
+ *---------------------------------------------------------------------------*/
+bool WidgetIndex::isEnabled() {
+  return root != nullptr;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Marks the index as outdated. It is rebuilt at the next query.
+ *
+ *---------------------------------------------------------------------------*/
+void WidgetIndex::invalidate() {
+  dirty = true;
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Adds a widget and all its descendants to the widget table, in pre-order.
+ *  The parent is taken from the child/sibling chains match() walks, rather
+ *  than from the parent pointer, which add() does not set.
+ *
+ *  w            The widget to add
+ *  parent       The table index of its parent, WIDGET_INDEX_ROOT for the root
+ *
+ *---------------------------------------------------------------------------*/
+void WidgetIndex::collect(Widget* w, uint8_t parent) {
+
+  if (count >= WIDGET_INDEX_MAX_WIDGETS) {
+	overflow = true;
+	return;
+  }
+
+  uint8_t self = count++;
+  widgets[self] = w;
+  parents[self] = parent;
+
+  for (Widget* c = w->child; c; c = c->sibling)
+	collect(c, self);
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Rebuilds the widget table and the grid from the widget tree.
+ *  Sets overflow if the index cannot be used, in which case queries fall
+ *  back to Widget::match() until the tree changes again.
+ *
+ *---------------------------------------------------------------------------*/
+void WidgetIndex::rebuild() {
+
+  rebuilds++;
+  dirty    = false;
+
+  //
+  //  Collect the widgets below the root in match() order
+  //
+  count    = 0;
+  overflow = false;
+  for (Widget* c = root->child; c; c = c->sibling)
+	collect(c, WIDGET_INDEX_ROOT);
+
+  if (overflow)
+	return;
+
+  //
+  //  Size the grid to the root, which changes with the rotation
+  //
+  uint16_t c = root->width  / WIDGET_INDEX_CELL_SIZE + 1;
+  uint16_t r = root->height / WIDGET_INDEX_CELL_SIZE + 1;
+  if (c > 255 || r > 255) {
+	overflow = true;
+	return;
+  }
+
+  if (c * r > capacity) {
+	free(cells);
+	cells    = (uint64_t*) malloc(c * r * sizeof(uint64_t));
+	capacity = cells ? c * r : 0;
+	if (! cells) {
+	  overflow = true;
+	  return;
+	}
+  }
+
+  columns = c;
+  rows    = r;
+  memset(cells, 0, columns * rows * sizeof(uint64_t));
+
+  //
+  //  Mark the cells overlapped by each widget.
+  //  Note that contains() includes the right and bottom edge.
+  //
+  int16_t maxX = root->x + root->width;
+  int16_t maxY = root->y + root->height;
+
+  for (uint8_t i = 0; i < count; i++) {
+	Widget* w = widgets[i];
+
+	int16_t x1 = max(w->x, root->x);
+	int16_t y1 = max(w->y, root->y);
+	int16_t x2 = min((int16_t)(w->x + w->width),  maxX);
+	int16_t y2 = min((int16_t)(w->y + w->height), maxY);
+	if (x1 > x2 || y1 > y2)
+	  continue;
+
+	uint8_t c1 = (x1 - root->x) / WIDGET_INDEX_CELL_SIZE;
+	uint8_t c2 = (x2 - root->x) / WIDGET_INDEX_CELL_SIZE;
+	uint8_t r1 = (y1 - root->y) / WIDGET_INDEX_CELL_SIZE;
+	uint8_t r2 = (y2 - root->y) / WIDGET_INDEX_CELL_SIZE;
+
+	uint64_t bit = (uint64_t)1 << i;
+	for (uint8_t row = r1; row <= r2; row++)
+	  for (uint8_t col = c1; col <= c2; col++)
+		cells[row * columns + col] |= bit;
+  }
+
+  #if DEBUG_INDEX
+  Serial.print(F("WidgetIndex::rebuild() widgets: ")); Serial.print(count);
+  Serial.print(F(" grid: ")); Serial.print(columns); Serial.print(F("x")); Serial.println(rows);
+  #endif
+}
+
+/*-----------------------------------------------------------------------------
+ *
+ *  Returns the deepest, topmost visible widget containing (x, y), exactly
+ *  like root->Widget::match() would, or nullptr if the root does not
+ *  contain the point.
+ *
+ *  pX           The x coordinate
+ *  pY           The y coordinate
+ *
+ *---------------------------------------------------------------------------*/
+Widget* WidgetIndex::match(int16_t pX, int16_t pY) {
+
+  if (dirty)
+	rebuild();
+
+  if (overflow) {
+	fallbacks++;
+	return root->Widget::match(pX, pY);
+  }
+
+  if (! root->contains(pX, pY))
+	return nullptr;
+
+  queries++;
+
+  int16_t col = (pX - root->x) / WIDGET_INDEX_CELL_SIZE;
+  int16_t row = (pY - root->y) / WIDGET_INDEX_CELL_SIZE;
+  if (col < 0 || col >= columns || row < 0 || row >= rows)
+	return root;
+
+  uint8_t  current = WIDGET_INDEX_ROOT;
+  uint64_t mask    = cells[row * columns + col];
+
+  while (mask) {
+	uint8_t i = __builtin_ctzll(mask);
+	mask &= mask - 1;
+
+	Widget* w = widgets[i];
+	if (parents[i] == current && w->isVisible() && w->contains(pX, pY))
+	  current = i;
+  }
+
+  return current == WIDGET_INDEX_ROOT ? root : widgets[current];
+}
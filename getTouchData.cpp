@@ -42,7 +42,9 @@
  *--------------------------------------------------------------------------*/
 #include <Arduino.h>
 #include <Terrabox_Widgets.h>
+#ifndef TERRABOX_HOST
 #include <TouchScreen.h>
+#endif
 
 #define DEBUG_SCREEN	0
 
@@ -52,6 +54,7 @@
  *
  *================================================================================*/
 
+#ifndef TERRABOX_HOST
 //
 // ALL Touch panels and wiring is DIFFERENT
 // Some magic numbers that worked for my development
@@ -128,24 +131,13 @@ bool getTouchData(XY* theTouch)
 
 /*-----------------------------------------------------------------------------------
  *
- *  This conventional C-function will gets raw touch data for you.
- *  In order to do so you have to use code similar to the code below.
- *
- *  struct XY data;
- *
- *  bool result = getRawTouchData(&data);
- *  if (result) {
- *  }
- *
+ *  Reads a raw sample from the touch panel itself, see getRawTouchData().
  *
  *  theTouch     The struct of type XY within which the raw touch data is passed,
- *               The data is only valid if getRawTouchData() returns true.
+ *               The data is only valid if readTouchPanel() returns true.
  *  
  *---------------------------------------------------------------------------------*/
-bool     pressedState   = false;
-uint32_t unpressedStart = 0;
-TSPoint  pLast(0, 0, 0);
-bool getRawTouchData(XY* theTouch)
+bool readTouchPanel(XY* theTouch)
 {
     TSPoint p = ts.getPoint();
     pinMode(YP, OUTPUT);      //restore shared pins
@@ -155,33 +147,6 @@ bool getRawTouchData(XY* theTouch)
 
     boolean pressed = (p.z > MINPRESSURE && p.z < MAXPRESSURE);
 
-    //
-    //  Filter for short dips in the pressed state
-    //
-    if (! pressed) {
-
-      uint32_t now = millis();
-
-      if (pressedState) {
-    	  pressedState   = false;
-    	  unpressedStart = now;
-      }
-
-      if (now - unpressedStart < 15) {
-    	pressed = true;
-    	p.x     = pLast.x;
-    	p.y     = pLast.y;
-    	p.z     = pLast.z;
-      }
-    }
-    else {
-    	if (!pressedState) {
-    		pressedState = true;
-    	}
-
-    	pLast = p;
-    }
-
     if (pressed) {
 
       #if DEBUG_SCREEN
@@ -211,6 +176,68 @@ bool getRawTouchData(XY* theTouch)
     return pressed;
 }
 
+#else
+/*-----------------------------------------------------------------------------------
+ *
+ *  On a PC there is no touch panel, so it is never touched. Unless touches
+ *  are supplied by a rawTouchSource.
+ *
+ *---------------------------------------------------------------------------------*/
+bool getTouchData(XY* theTouch)
+{
+    theTouch->x = 0;
+    theTouch->y = 0;
+
+    return false;
+}
+
+bool readTouchPanel(XY* theTouch)
+{
+    theTouch->x = -1;
+    theTouch->y = -1;
+    theTouch->z = 0;
+
+    return false;
+}
+#endif
+
+/*-----------------------------------------------------------------------------------
+ *
+ *  This conventional C-function will gets raw touch data for you.
+ *  In order to do so you have to use code similar to the code below.
+ *
+ *  struct XY data;
+ *
+ *  bool result = getRawTouchData(&data);
+ *  if (result) {
+ *  }
+ *
+ *  The sample comes from the rawTouchSource if one is set, otherwise from
+ *  the touch panel. It is stamped with the micros() at which it was taken
+ *  and then passed through the filter pipeline of Touch.filter.
+ *
+ *  theTouch     The struct of type XY within which the raw touch data is passed,
+ *               The data is only valid if getRawTouchData() returns true.
+ *  
+ *---------------------------------------------------------------------------------*/
+bool getRawTouchData(XY* theTouch)
+{
+    theTouch->stamp = micros();
+
+    bool pressed = rawTouchSource ? rawTouchSource(theTouch) : readTouchPanel(theTouch);
+
+    return Touch.filter.apply(theTouch, pressed);
+}
+
+/*-----------------------------------------------------------------------------------
+ *
+ *  If set, getRawTouchData() gets its samples from this function instead of the
+ *  touch panel. It gets the same XY to fill in and returns true if pressed.
+ *  This way a PC build can be driven by recorded or generated touches.
+ *
+ *---------------------------------------------------------------------------------*/
+bool (*rawTouchSource)(XY* data) = nullptr;
+
 /**---------------------------------------------------------------------------
  *
  *  Wait for a full tap. Implying detect low/high and high/low transition